@@ -1,6 +1,11 @@
 #include "include/AST.h"
 #include "include/CodeGenContext.h"
+#include "include/Log.h"
+#include "include/Array.h"
+#include "include/VisitorArrayUsage.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/MDBuilder.h"
 
 llvm::Value *IntegerLiteral::codeGeneration(CodeGenContext &context)
 {
@@ -14,24 +19,8 @@ llvm::Value *FloatLiteral::codeGeneration(CodeGenContext &context)
 
 llvm::Value *StringLiteral::codeGeneration(CodeGenContext &context)
 {
-    llvm::Constant *stringConstant = llvm::ConstantDataArray::getString(context.llvmContext, value, true);
-
-    llvm::GlobalVariable *globalString = new llvm::GlobalVariable(
-        *context.module,
-        stringConstant->getType(),
-        true,
-        llvm::GlobalValue::PrivateLinkage,
-        stringConstant,
-        ".str");
-
-    llvm::Value *stringPtr = context.builder.CreateInBoundsGEP(
-        globalString->getValueType(),
-        globalString,
-        {context.builder.getInt32(0), context.builder.getInt32(0)},
-        "str_ptr");
-
-    context.getGCManager().addObject(this);
-    return stringPtr;
+    // Occurrences of the same text share one constant
+    return context.internString(value);
 }
 
 llvm::Value *BoolLiteral::codeGeneration(CodeGenContext &context)
@@ -44,29 +33,35 @@ llvm::Value *CharLiteral::codeGeneration(CodeGenContext &context)
     return llvm::ConstantInt::get(llvm::Type::getInt8Ty(context.llvmContext), static_cast<uint8_t>(value));
 }
 
+static bool isBignum(llvm::Type *type);
+static bool isString(llvm::Type *type);
+
 llvm::Value *Identifier::codeGeneration(CodeGenContext &context)
 {
-    for (auto blockIt = context.blocks.rbegin(); blockIt != context.blocks.rend(); ++blockIt)
+    auto variable = context.lookupVariable(value);
+    if (variable.first && variable.second->isArrayTy())
     {
-        auto &locals = (*blockIt)->locals;
-        auto it = locals.find(value);
-        if (it != locals.end())
+        std::cerr << value << " is an array and can only be indexed or passed to a function." << "\n";
+        return nullptr;
+    }
+    if (variable.first)
+    {
+        llvm::Value *loaded = context.builder.CreateLoad(variable.second, variable.first, value);
+        // A function called later in the expression may assign the global and drop this value
+        if ((isBignum(variable.second) || isString(variable.second)) && llvm::isa<llvm::GlobalVariable>(variable.first))
         {
-            llvm::Value *varPtr = it->second.first;
-            llvm::Type *varType = it->second.second;
-            if (!varPtr)
-            {
-                std::cerr << "Null pointer for variable: " << value << "\n";
-                return nullptr;
-            }
-            return context.builder.CreateLoad(varType, varPtr, value);
+            context.rootValue(loaded);
         }
+        return loaded;
     }
 
     std::cerr << "Undefined identifier: " << value << "\n";
     return nullptr;
 }
 
+static llvm::Value *createBignumArithmetic(CodeGenContext &context, TokenType op, llvm::Value *left, llvm::Value *right, llvm::Value *slot);
+static llvm::Value *createArrayValue(CodeGenContext &context, Expression *expr, llvm::Type *arrayType, const std::string &what);
+
 llvm::Value *Unary::codeGeneration(CodeGenContext &context)
 {
     llvm::Value *operandValue = operand->codeGeneration(context);
@@ -77,6 +72,15 @@ llvm::Value *Unary::codeGeneration(CodeGenContext &context)
     switch (_operator.type)
     {
     case MINUS:
+        if (isString(operandValue->getType()))
+        {
+            std::cerr << "Cannot negate a string" << "\n";
+            return nullptr;
+        }
+        if (isBignum(operandValue->getType()))
+        {
+            return createBignumArithmetic(context, MINUS, context.builder.getInt64(1), operandValue, nullptr);
+        }
         return context.builder.CreateNeg(operandValue, "neg");
     case NOT:
         if (!operandValue->getType()->isIntegerTy())
@@ -91,17 +95,526 @@ llvm::Value *Unary::codeGeneration(CodeGenContext &context)
     }
 }
 
+// Integer division traps on a zero divisor and on MIN / -1, which would take
+// a --serve daemon down with the program. Branches to a call of
+// dnm_division_error in either case.
+static void createDivisionCheck(CodeGenContext &context, llvm::Value *left, llvm::Value *right)
+{
+    llvm::IRBuilder<> &builder = context.builder;
+    llvm::Function *function = builder.GetInsertBlock()->getParent();
+    llvm::IntegerType *type = llvm::cast<llvm::IntegerType>(right->getType());
+    llvm::BasicBlock *failBlock = llvm::BasicBlock::Create(context.llvmContext, "divisionFailed", function);
+    llvm::BasicBlock *okBlock = llvm::BasicBlock::Create(context.llvmContext, "divisionOk", function);
+
+    llvm::Value *isZero = builder.CreateICmpEQ(right, llvm::ConstantInt::get(type, 0), "divisorZero");
+    llvm::Value *isMinimum = builder.CreateICmpEQ(left, llvm::ConstantInt::get(context.llvmContext, llvm::APInt::getSignedMinValue(type->getBitWidth())));
+    llvm::Value *isMinusOne = builder.CreateICmpEQ(right, llvm::ConstantInt::getSigned(type, -1));
+    llvm::Value *overflow = builder.CreateAnd(isMinimum, isMinusOne, "divisionOverflow");
+    llvm::MDNode *weights = llvm::MDBuilder(context.llvmContext).createBranchWeights(1, 1 << 20);
+    builder.CreateCondBr(builder.CreateOr(isZero, overflow), failBlock, okBlock, weights);
+
+    builder.SetInsertPoint(failBlock);
+    llvm::FunctionCallee divisionError = context.module->getOrInsertFunction("dnm_division_error",
+        builder.getVoidTy(), builder.getInt32Ty());
+    if (auto callee = llvm::dyn_cast<llvm::Function>(divisionError.getCallee()))
+    {
+        callee->setDoesNotReturn();
+        callee->addFnAttr(llvm::Attribute::Cold);
+    }
+    builder.CreateCall(divisionError, {builder.CreateZExt(overflow, builder.getInt32Ty())});
+    builder.CreateUnreachable();
+
+    builder.SetInsertPoint(okBlock);
+}
+
+// bigint division. Most bigint values fit in 64 bits, where a single hardware
+// divide does the job; only genuinely wide operands go to dnm_i128_divrem.
+// INT64_MIN is kept off the fast path because INT64_MIN / -1 overflows i64.
+static llvm::Value *createBigintDivision(CodeGenContext &context, llvm::Value *left, llvm::Value *right, bool remainder)
+{
+    llvm::IRBuilder<> &builder = context.builder;
+    llvm::Type *wideType = left->getType();
+    llvm::Type *int64Type = builder.getInt64Ty();
+    createDivisionCheck(context, left, right);
+    llvm::Function *function = builder.GetInsertBlock()->getParent();
+
+    llvm::Value *leftNarrow = builder.CreateTrunc(left, int64Type, "leftNarrow");
+    llvm::Value *rightNarrow = builder.CreateTrunc(right, int64Type, "rightNarrow");
+    llvm::Value *leftFits = builder.CreateICmpEQ(builder.CreateSExt(leftNarrow, wideType), left);
+    llvm::Value *rightFits = builder.CreateICmpEQ(builder.CreateSExt(rightNarrow, wideType), right);
+    llvm::Value *noOverflow = builder.CreateICmpNE(leftNarrow, builder.getInt64(INT64_MIN));
+    llvm::Value *narrow = builder.CreateAnd(builder.CreateAnd(leftFits, rightFits), noOverflow, "narrowDivision");
+
+    llvm::BasicBlock *narrowBlock = llvm::BasicBlock::Create(context.llvmContext, "narrowDivision", function);
+    llvm::BasicBlock *wideBlock = llvm::BasicBlock::Create(context.llvmContext, "wideDivision", function);
+    llvm::BasicBlock *mergeBlock = llvm::BasicBlock::Create(context.llvmContext, "divisionDone", function);
+    builder.CreateCondBr(narrow, narrowBlock, wideBlock);
+
+    builder.SetInsertPoint(narrowBlock);
+    llvm::Value *narrowResult = remainder ? builder.CreateSRem(leftNarrow, rightNarrow)
+                                          : builder.CreateSDiv(leftNarrow, rightNarrow);
+    narrowResult = builder.CreateSExt(narrowResult, wideType);
+    builder.CreateBr(mergeBlock);
+
+    builder.SetInsertPoint(wideBlock);
+    // The result buffer lives in the entry block so a division inside a loop
+    // does not grow the stack on every iteration
+    llvm::IRBuilder<> entryBuilder(&function->getEntryBlock(), function->getEntryBlock().begin());
+    llvm::Type *resultType = llvm::ArrayType::get(int64Type, 4);
+    llvm::Value *resultBuffer = entryBuilder.CreateAlloca(resultType, nullptr, "divisionResult");
+
+    llvm::FunctionType *divremType = llvm::FunctionType::get(
+        builder.getVoidTy(),
+        {int64Type, int64Type, int64Type, int64Type, llvm::PointerType::get(builder.getInt8Ty(), 0)},
+        false);
+    llvm::FunctionCallee divrem = context.module->getOrInsertFunction("dnm_i128_divrem", divremType);
+    llvm::Value *leftHigh = builder.CreateTrunc(builder.CreateLShr(left, 64), int64Type);
+    llvm::Value *rightHigh = builder.CreateTrunc(builder.CreateLShr(right, 64), int64Type);
+    builder.CreateCall(divrem, {leftNarrow, leftHigh, rightNarrow, rightHigh, resultBuffer});
+
+    unsigned offset = remainder ? 2 : 0;
+    llvm::Value *low = builder.CreateLoad(int64Type, builder.CreateConstInBoundsGEP2_32(resultType, resultBuffer, 0, offset));
+    llvm::Value *high = builder.CreateLoad(int64Type, builder.CreateConstInBoundsGEP2_32(resultType, resultBuffer, 0, offset + 1));
+    llvm::Value *wideResult = builder.CreateOr(
+        builder.CreateZExt(low, wideType),
+        builder.CreateShl(builder.CreateZExt(high, wideType), 64));
+    wideBlock = builder.GetInsertBlock();
+    builder.CreateBr(mergeBlock);
+
+    builder.SetInsertPoint(mergeBlock);
+    llvm::PHINode *result = builder.CreatePHI(wideType, 2, remainder ? "remtmp" : "divtmp");
+    result->addIncoming(narrowResult, narrowBlock);
+    result->addIncoming(wideResult, wideBlock);
+    return result;
+}
+
+// bignum values are tagged i64 words (see Bignum.h); no other language type
+// is 64 bits wide, so the LLVM type identifies them.
+static bool isBignum(llvm::Type *type)
+{
+    return type->isIntegerTy(64);
+}
+
+// string values are tagged words as well (see Strings.h), typed as pointers
+// so they stay apart from bignums. Arrays are pointers too, but are never
+// the value of an expression: array variables and calls returning arrays
+// are only accepted by createArrayValue.
+static bool isString(llvm::Type *type)
+{
+    return type->isPointerTy();
+}
+
+static llvm::Type *stringType(CodeGenContext &context)
+{
+    return llvm::PointerType::get(context.builder.getInt8Ty(), 0);
+}
+
+// Whether evaluating the expression may call a function. A collection at the
+// callee's entry may move young objects, so heap values computed before the
+// call have to be read back from a root slot after it.
+static bool mayCollect(Expression *expr)
+{
+    if (dynamic_cast<CallFunction *>(expr))
+    {
+        return true;
+    }
+    if (auto unary = dynamic_cast<Unary *>(expr))
+    {
+        return mayCollect(unary->operand.get());
+    }
+    if (auto binary = dynamic_cast<Binary *>(expr))
+    {
+        return mayCollect(binary->leftOperand.get()) || mayCollect(binary->rightOperand.get());
+    }
+    if (auto comparison = dynamic_cast<Comparison *>(expr))
+    {
+        return mayCollect(comparison->leftOperand.get()) || mayCollect(comparison->rightOperand.get());
+    }
+    if (auto access = dynamic_cast<ArrayAccess *>(expr))
+    {
+        return mayCollect(access->index.get());
+    }
+    if (auto assignment = dynamic_cast<Assignment *>(expr))
+    {
+        return mayCollect(assignment->identifier.get()) || mayCollect(assignment->value.get());
+    }
+    return false;
+}
+
+// Parks a bignum or array value in a root slot when `later` is evaluated
+// before the value is used; readBack then returns its possibly moved copy
+static llvm::AllocaInst *keepAcross(CodeGenContext &context, llvm::Value *value, Expression *later)
+{
+    if (!value || !mayCollect(later) || !(isBignum(value->getType()) || value->getType()->isPointerTy()))
+    {
+        return nullptr;
+    }
+    return context.rootValue(value);
+}
+
+static llvm::Value *readBack(CodeGenContext &context, llvm::Value *value, llvm::AllocaInst *slot)
+{
+    return slot ? context.builder.CreateLoad(value->getType(), slot) : value;
+}
+
+static llvm::Value *toBignum(CodeGenContext &context, llvm::Value *value)
+{
+    llvm::IRBuilder<> &builder = context.builder;
+    llvm::Type *type = value->getType();
+    llvm::Type *int64Type = builder.getInt64Ty();
+    if (isBignum(type))
+    {
+        return value;
+    }
+    if (type->isIntegerTy(128))
+    {
+        llvm::FunctionType *fromType = llvm::FunctionType::get(int64Type, {int64Type, int64Type}, false);
+        llvm::FunctionCallee from = context.module->getOrInsertFunction("dnm_big_from_i128", fromType);
+        llvm::Value *low = builder.CreateTrunc(value, int64Type);
+        llvm::Value *high = builder.CreateTrunc(builder.CreateLShr(value, 64), int64Type);
+        llvm::Value *bignum = builder.CreateCall(from, {low, high}, "bignum");
+        context.rootValue(bignum);
+        return bignum;
+    }
+    if (type->isIntegerTy())
+    {
+        // Anything up to 32 bits fits inline
+        llvm::Value *wide = type->isIntegerTy(32) ? builder.CreateSExt(value, int64Type)
+                                                  : builder.CreateZExt(value, int64Type);
+        return builder.CreateOr(builder.CreateShl(wide, 1), 1, "bignum");
+    }
+    std::cerr << "Cannot convert value to bignum" << "\n";
+    return nullptr;
+}
+
+// Results of arithmetic and concatenation are fresh; a bignum or string read
+// from a variable, an array or a call may be held elsewhere too. Copying such
+// a value must end in-place updates through its owning slot (dnm_big_share,
+// dnm_str_share). Constants, such as literals, never have an owner.
+static void shareValue(CodeGenContext &context, Expression *source, llvm::Value *value)
+{
+    llvm::Type *type = value->getType();
+    if (!(isBignum(type) || isString(type)) || llvm::isa<llvm::Constant>(value) ||
+        dynamic_cast<Binary *>(source) || dynamic_cast<Unary *>(source))
+    {
+        return;
+    }
+    llvm::FunctionType *shareType = llvm::FunctionType::get(context.builder.getVoidTy(), {type}, false);
+    context.builder.CreateCall(context.module->getOrInsertFunction(isBignum(type) ? "dnm_big_share" : "dnm_str_share", shareType), {value});
+}
+
+// bignum +, - and * run inline while both operands and the result fit in 63
+// bits: with tagged words a = 2x+1 and b = 2y+1,
+//   a + (b-1) = 2(x+y)+1,  a - (b-1) = 2(x-y)+1,  (a>>1) * (b-1) + 1 = 2xy+1
+// and the 64-bit overflow flags are exactly the 63-bit ones. Otherwise, and
+// for / and %, the runtime takes over. With a slot the result is written back
+// to the slot's own number where possible (acc = acc op x). Numbers the
+// runtime returns are kept in a root slot, as nothing else refers to them yet.
+static llvm::Value *createBignumArithmetic(CodeGenContext &context, TokenType op, llvm::Value *left, llvm::Value *right, llvm::Value *slot)
+{
+    llvm::IRBuilder<> &builder = context.builder;
+    llvm::Type *int64Type = builder.getInt64Ty();
+    llvm::FunctionType *binaryType = llvm::FunctionType::get(int64Type, {int64Type, int64Type}, false);
+
+    const char *runtimeName;
+    const char *assignName = nullptr;
+    llvm::Intrinsic::ID overflowIntrinsic = llvm::Intrinsic::not_intrinsic;
+    switch (op)
+    {
+    case PLUS:
+        runtimeName = "dnm_big_add";
+        assignName = "dnm_big_add_assign";
+        overflowIntrinsic = llvm::Intrinsic::sadd_with_overflow;
+        break;
+    case MINUS:
+        runtimeName = "dnm_big_sub";
+        assignName = "dnm_big_sub_assign";
+        overflowIntrinsic = llvm::Intrinsic::ssub_with_overflow;
+        break;
+    case MULTIPLY:
+        runtimeName = "dnm_big_mul";
+        assignName = "dnm_big_mul_assign";
+        overflowIntrinsic = llvm::Intrinsic::smul_with_overflow;
+        break;
+    case DIVIDE:
+    {
+        llvm::Value *quotient = builder.CreateCall(context.module->getOrInsertFunction("dnm_big_div", binaryType), {left, right}, "bigdiv");
+        context.rootValue(quotient);
+        return quotient;
+    }
+    case MODULO:
+    {
+        llvm::Value *remainder = builder.CreateCall(context.module->getOrInsertFunction("dnm_big_rem", binaryType), {left, right}, "bigrem");
+        context.rootValue(remainder);
+        return remainder;
+    }
+    default:
+        std::cerr << "Unsupported operator for bignum" << "\n";
+        return nullptr;
+    }
+
+    llvm::Function *function = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *inlineBlock = llvm::BasicBlock::Create(context.llvmContext, "bignumInline", function);
+    llvm::BasicBlock *runtimeBlock = llvm::BasicBlock::Create(context.llvmContext, "bignumRuntime", function);
+    llvm::BasicBlock *doneBlock = llvm::BasicBlock::Create(context.llvmContext, "bignumDone", function);
+
+    llvm::Value *bothInline = builder.CreateTrunc(builder.CreateAnd(left, right), builder.getInt1Ty(), "bothInline");
+    builder.CreateCondBr(bothInline, inlineBlock, runtimeBlock);
+
+    builder.SetInsertPoint(inlineBlock);
+    llvm::Value *rightDoubled = builder.CreateSub(right, builder.getInt64(1));
+    llvm::Value *first = op == MULTIPLY ? builder.CreateAShr(left, 1) : left;
+    llvm::Value *withOverflow = builder.CreateBinaryIntrinsic(overflowIntrinsic, first, rightDoubled);
+    llvm::Value *inlineResult = builder.CreateExtractValue(withOverflow, 0);
+    if (op == MULTIPLY)
+    {
+        inlineResult = builder.CreateOr(inlineResult, 1);
+    }
+    builder.CreateCondBr(builder.CreateExtractValue(withOverflow, 1), runtimeBlock, doneBlock);
+
+    builder.SetInsertPoint(runtimeBlock);
+    llvm::Value *runtimeResult;
+    if (slot)
+    {
+        llvm::FunctionType *assignType = llvm::FunctionType::get(
+            builder.getVoidTy(), {llvm::PointerType::get(int64Type, 0), int64Type, int64Type}, false);
+        builder.CreateCall(context.module->getOrInsertFunction(assignName, assignType), {slot, left, right});
+        runtimeResult = builder.CreateLoad(int64Type, slot);
+    }
+    else
+    {
+        runtimeResult = builder.CreateCall(context.module->getOrInsertFunction(runtimeName, binaryType), {left, right});
+        context.rootValue(runtimeResult);
+    }
+    builder.CreateBr(doneBlock);
+
+    builder.SetInsertPoint(doneBlock);
+    llvm::PHINode *result = builder.CreatePHI(int64Type, 2, "bignum");
+    result->addIncoming(inlineResult, inlineBlock);
+    result->addIncoming(runtimeResult, runtimeBlock);
+    return result;
+}
+
+// Inline words compare like the integers they hold, since tagging preserves order
+static llvm::Value *createBignumComparison(CodeGenContext &context, llvm::CmpInst::Predicate predicate, llvm::Value *left, llvm::Value *right)
+{
+    llvm::IRBuilder<> &builder = context.builder;
+    llvm::Function *function = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *inlineBlock = builder.GetInsertBlock();
+    llvm::BasicBlock *runtimeBlock = llvm::BasicBlock::Create(context.llvmContext, "bignumCompare", function);
+    llvm::BasicBlock *doneBlock = llvm::BasicBlock::Create(context.llvmContext, "bignumCompared", function);
+
+    llvm::Value *inlineResult = builder.CreateICmp(predicate, left, right);
+    llvm::Value *bothInline = builder.CreateTrunc(builder.CreateAnd(left, right), builder.getInt1Ty(), "bothInline");
+    builder.CreateCondBr(bothInline, doneBlock, runtimeBlock);
+
+    builder.SetInsertPoint(runtimeBlock);
+    llvm::FunctionType *compareType = llvm::FunctionType::get(
+        builder.getInt32Ty(), {builder.getInt64Ty(), builder.getInt64Ty()}, false);
+    llvm::Value *order = builder.CreateCall(context.module->getOrInsertFunction("dnm_big_compare", compareType), {left, right});
+    llvm::Value *runtimeResult = builder.CreateICmp(predicate, order, builder.getInt32(0));
+    builder.CreateBr(doneBlock);
+
+    builder.SetInsertPoint(doneBlock);
+    llvm::PHINode *result = builder.CreatePHI(builder.getInt1Ty(), 2, "cmptmp");
+    result->addIncoming(inlineResult, inlineBlock);
+    result->addIncoming(runtimeResult, runtimeBlock);
+    return result;
+}
+
+// A char is added to a string as the one-byte string, held inline
+static llvm::Value *toStringValue(CodeGenContext &context, llvm::Value *value)
+{
+    llvm::IRBuilder<> &builder = context.builder;
+    if (isString(value->getType()))
+    {
+        return value;
+    }
+    if (value->getType()->isIntegerTy(8))
+    {
+        llvm::Value *word = builder.CreateOr(builder.CreateShl(builder.CreateZExt(value, builder.getInt64Ty()), 8), 1 << 1 | 1);
+        return builder.CreateIntToPtr(word, stringType(context), "string");
+    }
+    std::cerr << "Cannot convert value to string" << "\n";
+    return nullptr;
+}
+
+// Strings only add up: the result is inline when it fits, otherwise a new
+// string the runtime allocates, rooted like other fresh heap values
+static llvm::Value *createStringConcatenation(CodeGenContext &context, TokenType op, llvm::Value *left, llvm::Value *right)
+{
+    if (op != PLUS)
+    {
+        std::cerr << "Unsupported operator for string" << "\n";
+        return nullptr;
+    }
+    left = toStringValue(context, left);
+    right = toStringValue(context, right);
+    if (!left || !right)
+    {
+        return nullptr;
+    }
+    llvm::Type *type = stringType(context);
+    llvm::FunctionType *concatType = llvm::FunctionType::get(type, {type, type}, false);
+    llvm::Value *result = context.builder.CreateCall(context.module->getOrInsertFunction("dnm_str_concat", concatType), {left, right}, "concat");
+    context.rootValue(result);
+    return result;
+}
+
+// Equal words are always equal strings. Short strings are always inline, so
+// an inline string only equals its own word, and == and != only ask the
+// runtime about two strings that are both out of line. Occurrences of a
+// literal share one constant, so comparing to the literal a variable was
+// set from is decided inline too.
+static llvm::Value *createStringComparison(CodeGenContext &context, llvm::CmpInst::Predicate predicate, llvm::Value *left, llvm::Value *right)
+{
+    llvm::IRBuilder<> &builder = context.builder;
+    llvm::FunctionType *compareType = llvm::FunctionType::get(builder.getInt32Ty(), {left->getType(), right->getType()}, false);
+    llvm::FunctionCallee compare = context.module->getOrInsertFunction("dnm_str_compare", compareType);
+    if (predicate != llvm::CmpInst::ICMP_EQ && predicate != llvm::CmpInst::ICMP_NE)
+    {
+        return builder.CreateICmp(predicate, builder.CreateCall(compare, {left, right}), builder.getInt32(0), "cmptmp");
+    }
+
+    llvm::Function *function = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *inlineBlock = builder.GetInsertBlock();
+    llvm::BasicBlock *runtimeBlock = llvm::BasicBlock::Create(context.llvmContext, "stringCompare", function);
+    llvm::BasicBlock *doneBlock = llvm::BasicBlock::Create(context.llvmContext, "stringCompared", function);
+
+    llvm::Value *leftWord = builder.CreatePtrToInt(left, builder.getInt64Ty());
+    llvm::Value *rightWord = builder.CreatePtrToInt(right, builder.getInt64Ty());
+    llvm::Value *inlineResult = builder.CreateICmp(predicate, leftWord, rightWord);
+    llvm::Value *anyInline = builder.CreateTrunc(builder.CreateOr(leftWord, rightWord), builder.getInt1Ty(), "anyInline");
+    builder.CreateCondBr(builder.CreateOr(builder.CreateICmpEQ(leftWord, rightWord), anyInline), doneBlock, runtimeBlock);
+
+    builder.SetInsertPoint(runtimeBlock);
+    llvm::Value *order = builder.CreateCall(compare, {left, right});
+    llvm::Value *runtimeResult = builder.CreateICmp(predicate, order, builder.getInt32(0));
+    builder.CreateBr(doneBlock);
+
+    builder.SetInsertPoint(doneBlock);
+    llvm::PHINode *result = builder.CreatePHI(builder.getInt1Ty(), 2, "cmptmp");
+    result->addIncoming(inlineResult, inlineBlock);
+    result->addIncoming(runtimeResult, runtimeBlock);
+    return result;
+}
+
+// Value of an expression used as a condition, as i1
+static llvm::Value *toCondition(CodeGenContext &context, llvm::Value *value)
+{
+    llvm::Type *type = value->getType();
+    if (type->isIntegerTy(1))
+    {
+        return value;
+    }
+    if (type->isIntegerTy())
+    {
+        // bignum zero is the inline word 1
+        return context.builder.CreateICmpNE(value, llvm::ConstantInt::get(type, isBignum(type) ? 1 : 0), "tobool");
+    }
+    std::cerr << "Condition must be a boolean or an integer" << "\n";
+    return nullptr;
+}
+
+static bool isLogicalOperator(Expression *expr)
+{
+    Binary *binary = dynamic_cast<Binary *>(expr);
+    return binary && (binary->_operator.type == LOGICAL_AND || binary->_operator.type == LOGICAL_OR);
+}
+
+// Branches to trueBlock or falseBlock on expr. && and || become control flow,
+// so a right operand only runs when the left one does not decide the result.
+// Without profile data, reaching the right operand is assumed to be the
+// common case: guards like `n == 0 || n == 1` or `i < n && a[i]` mostly pass.
+static bool createConditionBranch(CodeGenContext &context, Expression *expr, llvm::BasicBlock *trueBlock, llvm::BasicBlock *falseBlock,
+                                  llvm::MDNode *weights = nullptr)
+{
+    if (isLogicalOperator(expr))
+    {
+        Binary *binary = static_cast<Binary *>(expr);
+        bool isAnd = binary->_operator.type == LOGICAL_AND;
+        llvm::Function *function = context.builder.GetInsertBlock()->getParent();
+        llvm::BasicBlock *rightBlock = llvm::BasicBlock::Create(context.llvmContext, isAnd ? "and.rhs" : "or.rhs", function);
+        llvm::MDBuilder mdBuilder(context.llvmContext);
+        bool leftDone = isAnd
+                            ? createConditionBranch(context, binary->leftOperand.get(), rightBlock, falseBlock, mdBuilder.createBranchWeights(3, 1))
+                            : createConditionBranch(context, binary->leftOperand.get(), trueBlock, rightBlock, mdBuilder.createBranchWeights(1, 3));
+        if (!leftDone)
+        {
+            return false;
+        }
+        context.builder.SetInsertPoint(rightBlock);
+        return createConditionBranch(context, binary->rightOperand.get(), trueBlock, falseBlock);
+    }
+
+    llvm::Value *value = expr->codeGeneration(context);
+    llvm::Value *condition = value ? toCondition(context, value) : nullptr;
+    if (!condition)
+    {
+        return false;
+    }
+    context.builder.CreateCondBr(condition, trueBlock, falseBlock, weights);
+    return true;
+}
+
+// && and || outside of a condition: branch, then merge into an i1
+static llvm::Value *createLogicalValue(CodeGenContext &context, Binary *expr)
+{
+    llvm::Function *function = context.builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *trueBlock = llvm::BasicBlock::Create(context.llvmContext, "logic.true", function);
+    llvm::BasicBlock *falseBlock = llvm::BasicBlock::Create(context.llvmContext, "logic.false", function);
+    llvm::BasicBlock *mergeBlock = llvm::BasicBlock::Create(context.llvmContext, "logic.end", function);
+    if (!createConditionBranch(context, expr, trueBlock, falseBlock))
+    {
+        return nullptr;
+    }
+
+    context.builder.SetInsertPoint(trueBlock);
+    context.builder.CreateBr(mergeBlock);
+    context.builder.SetInsertPoint(falseBlock);
+    context.builder.CreateBr(mergeBlock);
+
+    context.builder.SetInsertPoint(mergeBlock);
+    llvm::PHINode *result = context.builder.CreatePHI(context.builder.getInt1Ty(), 2, "logictmp");
+    result->addIncoming(context.builder.getTrue(), trueBlock);
+    result->addIncoming(context.builder.getFalse(), falseBlock);
+    return result;
+}
+
 llvm::Value *Binary::codeGeneration(CodeGenContext &context)
 {
+    if (isLogicalOperator(this))
+    {
+        return createLogicalValue(context, this);
+    }
+
     llvm::Value *leftValue = leftOperand->codeGeneration(context);
+    llvm::AllocaInst *leftKept = keepAcross(context, leftValue, rightOperand.get());
     llvm::Value *rightValue = rightOperand->codeGeneration(context);
     if ((leftValue == nullptr) || (rightValue == nullptr))
     {
         return nullptr;
     }
+    leftValue = readBack(context, leftValue, leftKept);
     llvm::Type *leftType = leftValue->getType();
     llvm::Type *rightType = rightValue->getType();
 
+    if (isString(leftType) || isString(rightType))
+    {
+        return createStringConcatenation(context, _operator.type, leftValue, rightValue);
+    }
+
+    if (isBignum(leftType) || isBignum(rightType))
+    {
+        leftValue = toBignum(context, leftValue);
+        rightValue = toBignum(context, rightValue);
+        if (!leftValue || !rightValue)
+        {
+            return nullptr;
+        }
+        return createBignumArithmetic(context, _operator.type, leftValue, rightValue, nullptr);
+    }
+
     if (leftType != rightType)
     {
         if (leftType->isIntegerTy() && rightType->isFloatingPointTy())
@@ -134,11 +647,6 @@ llvm::Value *Binary::codeGeneration(CodeGenContext &context)
     }
 
     bool isDoubleTy = rightValue->getType()->isFloatingPointTy();
-    if (isDoubleTy && (_operator.type == LOGICAL_AND || _operator.type == LOGICAL_OR))
-    {
-        std::cerr << "Binary operation (AND, OR) on floating point value is not supported" << "\n";
-        return nullptr;
-    }
 
     llvm::Instruction::BinaryOps instr;
     switch (_operator.type)
@@ -153,37 +661,66 @@ llvm::Value *Binary::codeGeneration(CodeGenContext &context)
         isDoubleTy ? instr = llvm::Instruction::FMul : instr = llvm::Instruction::Mul;
         break;
     case DIVIDE:
+        if (rightValue->getType()->isIntegerTy(128))
+        {
+            return createBigintDivision(context, leftValue, rightValue, false);
+        }
         isDoubleTy ? instr = llvm::Instruction::FDiv : instr = llvm::Instruction::SDiv;
         break;
-    case LOGICAL_AND:
-        instr = llvm::Instruction::And;
-        break;
-    case LOGICAL_OR:
-        instr = llvm::Instruction::Or;
+    case MODULO:
+        if (rightValue->getType()->isIntegerTy(128))
+        {
+            return createBigintDivision(context, leftValue, rightValue, true);
+        }
+        isDoubleTy ? instr = llvm::Instruction::FRem : instr = llvm::Instruction::SRem;
         break;
     default:
         std::cerr << "Unknown binary operator" << "\n";
         return nullptr;
     }
 
-    context.getGCManager().addObject(this);
-
+    if (instr == llvm::Instruction::SDiv || instr == llvm::Instruction::SRem)
+    {
+        createDivisionCheck(context, leftValue, rightValue);
+    }
     return context.builder.CreateBinOp(instr, leftValue, rightValue, "mathtmp");
 }
 
 llvm::Value *Comparison::codeGeneration(CodeGenContext &context)
 {
     llvm::Value *leftValue = leftOperand->codeGeneration(context);
+    llvm::AllocaInst *leftKept = keepAcross(context, leftValue, rightOperand.get());
     llvm::Value *rightValue = rightOperand->codeGeneration(context);
     if ((leftValue == nullptr) || (rightValue == nullptr))
     {
         return nullptr;
     }
+    leftValue = readBack(context, leftValue, leftKept);
 
     llvm::Type *leftType = leftValue->getType();
     llvm::Type *rightType = rightValue->getType();
+    bool bignum = isBignum(leftType) || isBignum(rightType);
+    bool string = isString(leftType) || isString(rightType);
 
-    if (leftType != rightType)
+    if (string)
+    {
+        leftValue = toStringValue(context, leftValue);
+        rightValue = toStringValue(context, rightValue);
+        if (!leftValue || !rightValue)
+        {
+            return nullptr;
+        }
+    }
+    else if (bignum)
+    {
+        leftValue = toBignum(context, leftValue);
+        rightValue = toBignum(context, rightValue);
+        if (!leftValue || !rightValue)
+        {
+            return nullptr;
+        }
+    }
+    else if (leftType != rightType)
     {
         if (leftType->isIntegerTy() && rightType->isFloatingPointTy())
         {
@@ -242,6 +779,15 @@ llvm::Value *Comparison::codeGeneration(CodeGenContext &context)
         return nullptr;
     }
 
+    if (string)
+    {
+        return createStringComparison(context, predicate, leftValue, rightValue);
+    }
+    if (bignum)
+    {
+        return createBignumComparison(context, predicate, leftValue, rightValue);
+    }
+
     return isDoubleTy
                ? context.builder.CreateFCmp(predicate, leftValue, rightValue, "cmptmp")
                : context.builder.CreateICmp(predicate, leftValue, rightValue, "cmptmp");
@@ -249,7 +795,17 @@ llvm::Value *Comparison::codeGeneration(CodeGenContext &context)
 
 llvm::Value *CallFunction::codeGeneration(CodeGenContext &context)
 {
-    llvm::Function *CalleeF = context.module->getFunction(functionName);
+    if (context.functionArrayType(functionName, functionArgs.size()))
+    {
+        std::cerr << functionName << " returns an array, which can only be bound to an array or passed to a function." << "\n";
+        return nullptr;
+    }
+    return createCall(context);
+}
+
+llvm::Value *CallFunction::createCall(CodeGenContext &context)
+{
+    llvm::Function *CalleeF = context.lookupFunction(functionName);
     if (!CalleeF)
     {
         std::cerr << "Unknown function referenced: " << functionName << "\n";
@@ -263,8 +819,29 @@ llvm::Value *CallFunction::codeGeneration(CodeGenContext &context)
     }
 
     std::vector<llvm::Value *> ArgsV;
+    // Heap arguments followed by a call are read back once all are evaluated
+    std::vector<llvm::AllocaInst *> keptArgs(functionArgs.size());
+    auto addArgument = [&](unsigned i, llvm::Value *value)
+    {
+        for (unsigned later = i + 1; later < functionArgs.size() && !keptArgs[i]; ++later)
+        {
+            keptArgs[i] = keepAcross(context, value, functionArgs[later].get());
+        }
+        ArgsV.push_back(value);
+    };
     for (unsigned i = 0; i < functionArgs.size(); ++i)
     {
+        // Arrays are passed as the pointer to their data, length included
+        if (llvm::Type *arrayType = context.functionArrayType(functionName, i))
+        {
+            llvm::Value *data = createArrayValue(context, functionArgs[i].get(), arrayType,
+                                                 "Argument " + std::to_string(i + 1) + " of " + functionName);
+            if (!data)
+                return nullptr;
+            addArgument(i, data);
+            continue;
+        }
+
         llvm::Value *argValue = functionArgs[i]->codeGeneration(context);
         if (!argValue)
         {
@@ -275,7 +852,30 @@ llvm::Value *CallFunction::codeGeneration(CodeGenContext &context)
         llvm::Type *expectedArgType = CalleeF->getArg(i)->getType();
         llvm::Type *argType = argValue->getType();
 
-        if (argType != expectedArgType)
+        if (isBignum(expectedArgType))
+        {
+            argValue = toBignum(context, argValue);
+            if (!argValue)
+            {
+                return nullptr;
+            }
+            shareValue(context, functionArgs[i].get(), argValue);
+        }
+        else if (isString(expectedArgType))
+        {
+            argValue = toStringValue(context, argValue);
+            if (!argValue)
+            {
+                return nullptr;
+            }
+            shareValue(context, functionArgs[i].get(), argValue);
+        }
+        else if (isBignum(argType))
+        {
+            std::cerr << "Cannot pass a bignum as a narrower argument to function: " << functionName << "\n";
+            return nullptr;
+        }
+        else if (argType != expectedArgType)
         {
             if (expectedArgType->isIntegerTy() && argType->isIntegerTy())
             {
@@ -313,7 +913,11 @@ llvm::Value *CallFunction::codeGeneration(CodeGenContext &context)
                 return nullptr;
             }
         }
-        ArgsV.push_back(argValue);
+        addArgument(i, argValue);
+    }
+    for (unsigned i = 0; i < ArgsV.size(); ++i)
+    {
+        ArgsV[i] = readBack(context, ArgsV[i], keptArgs[i]);
     }
 
     llvm::CallInst *callInst = context.builder.CreateCall(CalleeF, ArgsV);
@@ -323,54 +927,374 @@ llvm::Value *CallFunction::codeGeneration(CodeGenContext &context)
     }
 
     callInst->setName("calltmp");
+    // Returned heap values are only referenced from here until stored
+    if (isBignum(callInst->getType()) || isString(callInst->getType()) || context.functionArrayType(functionName, functionArgs.size()))
+    {
+        context.rootValue(callInst);
+    }
     return callInst;
 }
 
-llvm::Value *ArrayAccess::codeGeneration(CodeGenContext &context)
+// Arrays are recorded with a zero-length array type of their element type.
+// The variable itself holds a pointer to the element data, which is preceded
+// by an ArrayInfo wherever the array lives.
+static llvm::Type *arrayMarkerType(llvm::Type *elementType)
+{
+    return llvm::ArrayType::get(elementType, 0);
+}
+
+// Arrays of at most this many bytes are kept in the frame of the declaring
+// function when nothing can hold on to them past its return
+static const uint64_t MaxStackArrayBytes = 4096;
+
+// bool arrays are bitsets: 64 elements share each 64-bit word
+static bool isBitArray(llvm::Type *elementType)
 {
-    llvm::Value *arrayPtr = nullptr;
-    llvm::Type *arrayType = nullptr;
+    return elementType->isIntegerTy(1);
+}
 
-    for (auto blockIt = context.blocks.rbegin(); blockIt != context.blocks.rend(); ++blockIt)
+// An array element to read or write. For bitsets the pointer is to the word
+// holding the element and bit is its position in the word.
+struct ArrayElement
+{
+    llvm::Value *pointer;
+    llvm::Type *type;
+    llvm::Value *bit;
+};
+
+static ArrayElement createArrayElement(CodeGenContext &context, llvm::Type *elementType, llvm::Value *data, llvm::Value *index, const std::string &name)
+{
+    llvm::IRBuilder<> &builder = context.builder;
+    if (isBitArray(elementType))
     {
-        auto &locals = (*blockIt)->locals;
-        auto it = locals.find(identifier->value);
-        if (it != locals.end())
+        llvm::Value *word = builder.CreateLShr(index, 6, name + "_word");
+        llvm::Value *bit = builder.CreateAnd(index, 63, name + "_bit");
+        return {builder.CreateInBoundsGEP(builder.getInt64Ty(), data, word, name + "_word_ptr"), elementType, bit};
+    }
+    return {builder.CreateInBoundsGEP(elementType, data, index, name + "_elem_ptr"), elementType, nullptr};
+}
+
+static llvm::Value *loadArrayElement(CodeGenContext &context, const ArrayElement &element, const std::string &name)
+{
+    llvm::IRBuilder<> &builder = context.builder;
+    if (!element.bit)
+    {
+        return builder.CreateLoad(element.type, element.pointer, name + "_loaded");
+    }
+    llvm::Value *word = builder.CreateLoad(builder.getInt64Ty(), element.pointer, name + "_word");
+    return builder.CreateTrunc(builder.CreateLShr(word, element.bit), element.type, name + "_loaded");
+}
+
+static void storeArrayElement(CodeGenContext &context, const ArrayElement &element, llvm::Value *value)
+{
+    llvm::IRBuilder<> &builder = context.builder;
+    if (!element.bit)
+    {
+        builder.CreateStore(value, element.pointer);
+        return;
+    }
+    llvm::Value *word = builder.CreateLoad(builder.getInt64Ty(), element.pointer);
+    llvm::Value *mask = builder.CreateShl(builder.getInt64(1), element.bit);
+    llvm::Value *bitValue = builder.CreateShl(builder.CreateZExt(value, builder.getInt64Ty()), element.bit);
+    builder.CreateStore(builder.CreateOr(builder.CreateAnd(word, builder.CreateNot(mask)), bitValue), element.pointer);
+}
+
+// A value converted to the element type of an array, by the rules of
+// variable initialization; bool elements take any nonzero number as true
+static llvm::Value *toElementType(CodeGenContext &context, llvm::Value *value, llvm::Type *elementType, const std::string &name)
+{
+    llvm::IRBuilder<> &builder = context.builder;
+    llvm::Type *valueType = value->getType();
+    if (isBignum(valueType) || isString(valueType))
+    {
+        std::cerr << "Cannot store a " << (isString(valueType) ? "string" : "bignum") << " in an element of " << name << "\n";
+        return nullptr;
+    }
+    if (valueType == elementType)
+    {
+        return value;
+    }
+    if (isBitArray(elementType))
+    {
+        if (valueType->isFloatingPointTy())
         {
-            arrayPtr = it->second.first;
-            arrayType = it->second.second;
-            break;
+            return builder.CreateFCmpONE(value, llvm::ConstantFP::get(valueType, 0), "tobool");
         }
+        return builder.CreateICmpNE(value, llvm::ConstantInt::get(valueType, 0), "tobool");
     }
-    if (!arrayPtr)
+    if (elementType->isIntegerTy() && valueType->isIntegerTy())
     {
-        std::cerr << "Array " << identifier->value << " not declared." << "\n";
-        return nullptr;
+        // true is 1, not -1
+        return builder.CreateIntCast(value, elementType, !valueType->isIntegerTy(1), "cast");
+    }
+    if (elementType->isFloatingPointTy() && valueType->isIntegerTy())
+    {
+        return builder.CreateSIToFP(value, elementType, "int_to_float");
+    }
+    if (elementType->isIntegerTy() && valueType->isFloatingPointTy())
+    {
+        return builder.CreateFPToSI(value, elementType, "float_to_int");
+    }
+    std::cerr << "Type mismatch in assignment to an element of " << name << "\n";
+    return nullptr;
+}
+
+// The length of an array, from the ArrayInfo in front of its data
+static llvm::Value *loadArrayLength(CodeGenContext &context, llvm::Value *data, const std::string &name)
+{
+    llvm::IRBuilder<> &builder = context.builder;
+    llvm::Value *lengthPtr = builder.CreateConstInBoundsGEP1_64(builder.getInt64Ty(), data, -1, name + "_length_ptr");
+    return builder.CreateLoad(builder.getInt64Ty(), lengthPtr, name + "_length");
+}
+
+// Branches to a call of dnm_array_index_error unless 0 <= index < length.
+// One unsigned compare covers both ends.
+static void createBoundsCheck(CodeGenContext &context, const std::string &name, llvm::Value *data, llvm::Value *index)
+{
+    llvm::IRBuilder<> &builder = context.builder;
+    llvm::Function *function = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *failBlock = llvm::BasicBlock::Create(context.llvmContext, name + "_out_of_bounds", function);
+    llvm::BasicBlock *okBlock = llvm::BasicBlock::Create(context.llvmContext, name + "_in_bounds", function);
+
+    llvm::Value *length = loadArrayLength(context, data, name);
+    llvm::Value *inBounds = builder.CreateICmpULT(index, length, name + "_index_ok");
+    llvm::MDNode *weights = llvm::MDBuilder(context.llvmContext).createBranchWeights(1, 1 << 20);
+    builder.CreateCondBr(inBounds, okBlock, failBlock, weights);
+
+    builder.SetInsertPoint(failBlock);
+    llvm::FunctionCallee indexError = context.module->getOrInsertFunction("dnm_array_index_error",
+        builder.getVoidTy(), llvm::PointerType::get(builder.getInt8Ty(), 0), builder.getInt64Ty(), builder.getInt64Ty());
+    if (auto callee = llvm::dyn_cast<llvm::Function>(indexError.getCallee()))
+    {
+        callee->setDoesNotReturn();
+        callee->addFnAttr(llvm::Attribute::Cold);
+    }
+    builder.CreateCall(indexError, {builder.CreateGlobalStringPtr(name), index, length});
+    builder.CreateUnreachable();
+
+    builder.SetInsertPoint(okBlock);
+}
+
+// Evaluates the index of the access and, if given, the value to store there,
+// then addresses the element. The data pointer is read last, so a collection
+// in either expression cannot leave it pointing at a moved array.
+static bool createElementReference(CodeGenContext &context, ArrayAccess &access, ArrayElement &element,
+                                   Expression *value = nullptr, llvm::Value **valueResult = nullptr)
+{
+    const std::string &name = access.identifier->value;
+    Expression *index = access.index.get();
+    auto variable = context.lookupVariable(name);
+    llvm::Value *arraySlot = variable.first;
+    llvm::Type *arrayType = variable.second;
+    if (!arraySlot)
+    {
+        std::cerr << "Array " << name << " not declared." << "\n";
+        return false;
     }
 
     if (!arrayType->isArrayTy())
     {
-        std::cerr << identifier->value << " is not an array." << "\n";
-        return nullptr;
+        std::cerr << name << " is not an array." << "\n";
+        return false;
     }
 
-    llvm::Type *elementType = arrayType->getArrayElementType();
     llvm::Value *indexValue = index->codeGeneration(context);
-    llvm::Value *elementPtr = context.builder.CreateInBoundsGEP(
-        arrayType,
-        arrayPtr,
-        {context.builder.getInt32(0), indexValue},
-        identifier->value + "_access");
+    if (!indexValue)
+        return false;
+    if (!indexValue->getType()->isIntegerTy() || isBignum(indexValue->getType()))
+    {
+        std::cerr << "Index of " << name << " must be an integer." << "\n";
+        return false;
+    }
+    // Indexes are 64-bit so arrays can exceed 2^31 elements
+    indexValue = context.builder.CreateIntCast(indexValue, context.builder.getInt64Ty(),
+                                               !indexValue->getType()->isIntegerTy(1), "index");
+    if (value)
+    {
+        *valueResult = value->codeGeneration(context);
+        if (!*valueResult)
+            return false;
+    }
 
-    return context.builder.CreateLoad(elementType, elementPtr, identifier->value + "_loaded");
+    llvm::Value *data = context.builder.CreateLoad(llvm::PointerType::get(context.builder.getInt8Ty(), 0), arraySlot, name + "_data");
+    if (context.boundsCheck && !access.inBounds)
+        createBoundsCheck(context, name, data, indexValue);
+    element = createArrayElement(context, arrayType->getArrayElementType(), data, indexValue, name);
+    return true;
+}
+
+llvm::Value *ArrayAccess::codeGeneration(CodeGenContext &context)
+{
+    ArrayElement element;
+    if (!createElementReference(context, *this, element))
+        return nullptr;
+
+    return loadArrayElement(context, element, identifier->value);
 }
 
 llvm::Value *ExpressionStatement::codeGeneration(CodeGenContext &context)
 {
-    
+    // A call may drop the array it returns
+    if (auto call = dynamic_cast<CallFunction *>(expression.get()))
+    {
+        return call->createCall(context);
+    }
     return expression->codeGeneration(context);
 }
 
+// The data pointer of an array passed to or returned from a function: an
+// array variable, or a call of a function returning an array
+static llvm::Value *createArrayValue(CodeGenContext &context, Expression *expr, llvm::Type *arrayType, const std::string &what)
+{
+    llvm::Type *valueType = nullptr;
+    llvm::Value *data = nullptr;
+    if (auto identifier = dynamic_cast<Identifier *>(expr))
+    {
+        auto variable = context.lookupVariable(identifier->value);
+        if (!variable.first)
+        {
+            std::cerr << "Array " << identifier->value << " not declared." << "\n";
+            return nullptr;
+        }
+        valueType = variable.second;
+        if (valueType->isArrayTy())
+            data = context.builder.CreateLoad(llvm::PointerType::get(context.builder.getInt8Ty(), 0), variable.first, identifier->value + "_data");
+    }
+    else if (auto call = dynamic_cast<CallFunction *>(expr))
+    {
+        data = call->createCall(context);
+        if (!data)
+            return nullptr;
+        valueType = context.functionArrayType(call->functionName, call->functionArgs.size());
+    }
+
+    if (!data || !valueType || !valueType->isArrayTy())
+    {
+        std::cerr << what << " must be an array." << "\n";
+        return nullptr;
+    }
+    if (valueType != arrayType)
+    {
+        std::cerr << what << " has a different element type." << "\n";
+        return nullptr;
+    }
+    return data;
+}
+
+// Reserves the array in the entry block of the current function, in the same
+// layout as a heap array, and fills in its ArrayInfo where it is declared
+static llvm::Value *createStackArray(CodeGenContext &context, const std::string &name, uint64_t length, uint64_t elementSize)
+{
+    llvm::IRBuilder<> &builder = context.builder;
+    llvm::Function *function = builder.GetInsertBlock()->getParent();
+    llvm::IRBuilder<> entryBuilder(&function->getEntryBlock(), function->getEntryBlock().begin());
+    uint64_t storageSize = sizeof(ArrayInfo) + ArrayInfo::dataSize(length, elementSize);
+    llvm::AllocaInst *storage = entryBuilder.CreateAlloca(
+        llvm::ArrayType::get(builder.getInt8Ty(), storageSize), nullptr, name + "_storage");
+    storage->setAlignment(llvm::Align(16));
+
+    // Cleared on every execution of the declaration, like a fresh heap array
+    builder.CreateMemSet(storage, builder.getInt8(0), storageSize, llvm::Align(16));
+    builder.CreateStore(builder.getInt64(elementSize), storage);
+    builder.CreateStore(builder.getInt64(length),
+                        builder.CreateConstInBoundsGEP1_64(builder.getInt8Ty(), storage, offsetof(ArrayInfo, length)));
+    return builder.CreateConstInBoundsGEP1_64(builder.getInt8Ty(), storage, sizeof(ArrayInfo), name + "_data");
+}
+
+// Private constant holding packed initializer bytes
+static llvm::Constant *createConstantData(CodeGenContext &context, const std::string &name, const uint8_t *bytes, size_t size)
+{
+    llvm::Constant *initializer = llvm::ConstantDataArray::get(context.llvmContext, llvm::ArrayRef<uint8_t>(bytes, size));
+    llvm::GlobalVariable *global = new llvm::GlobalVariable(
+        *context.module, initializer->getType(), true, llvm::GlobalValue::PrivateLinkage, initializer, name + "_init");
+    global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+    global->setAlignment(llvm::Align(16));
+    return global;
+}
+
+// Bytes of element data, as ArrayInfo::dataSize computes them
+static llvm::Value *createDataSize(llvm::IRBuilder<> &builder, llvm::Value *length, uint64_t elementSize)
+{
+    if (elementSize)
+        return builder.CreateMul(length, builder.getInt64(elementSize));
+    llvm::Value *words = builder.CreateLShr(builder.CreateAdd(length, builder.getInt64(63)), 6);
+    return builder.CreateShl(words, 3);
+}
+
+// Writes the literal entries of an initializer list, packed one entry per
+// byte for bitsets. Array memory starts out zeroed, so only non-zero data is
+// written. A list of a single literal fills the whole array with it;
+// otherwise the list is copied to the front and the rest stays zero.
+static void createConstantInitializer(CodeGenContext &context, const std::string &name, const std::vector<uint8_t> &constantInit,
+                                      size_t entrySize, bool uniform, llvm::Value *data, llvm::Value *length, uint64_t elementSize)
+{
+    llvm::IRBuilder<> &builder = context.builder;
+    if (uniform)
+    {
+        uint8_t first = constantInit[0];
+        bool byteSplat = std::all_of(constantInit.begin(), constantInit.begin() + entrySize,
+                                     [first](uint8_t byte) { return byte == first; });
+        if (byteSplat && first == 0)
+            return;
+        if (byteSplat && elementSize)
+        {
+            builder.CreateMemSet(data, builder.getInt8(first), createDataSize(builder, length, elementSize), llvm::Align(16));
+            return;
+        }
+        llvm::FunctionCallee arrayFill = context.module->getOrInsertFunction(
+            "dnm_array_fill", builder.getVoidTy(), data->getType(), data->getType());
+        builder.CreateCall(arrayFill, {data, createConstantData(context, name, constantInit.data(), entrySize)});
+        return;
+    }
+
+    std::vector<uint8_t> packed = constantInit;
+    if (!elementSize)
+    {
+        std::vector<uint64_t> words((constantInit.size() + 63) / 64);
+        for (size_t i = 0; i < constantInit.size(); ++i)
+        {
+            words[i / 64] |= uint64_t(constantInit[i] != 0) << (i % 64);
+        }
+        packed.assign(reinterpret_cast<const uint8_t *>(words.data()),
+                      reinterpret_cast<const uint8_t *>(words.data() + words.size()));
+    }
+
+    llvm::Value *copySize = builder.getInt64(packed.size());
+    if (!llvm::isa<llvm::ConstantInt>(length))
+    {
+        copySize = builder.CreateBinaryIntrinsic(llvm::Intrinsic::umin, createDataSize(builder, length, elementSize), copySize);
+    }
+    builder.CreateMemCpy(data, llvm::Align(16), createConstantData(context, name, packed.data(), packed.size()),
+                         llvm::Align(16), copySize);
+}
+
+// Declares the variable of an array, holding a pointer to its data
+static llvm::Value *createArraySlot(CodeGenContext &context, const std::string &name, llvm::Type *arrayType, llvm::Value *data)
+{
+    llvm::Type *slotType = data->getType();
+    llvm::Value *arraySlot;
+    if (context.isGlobalScope())
+    {
+        auto global = new llvm::GlobalVariable(*context.module, slotType, false, llvm::GlobalValue::ExternalLinkage,
+                                               llvm::Constant::getNullValue(slotType), name);
+        context.declareGlobal(name, arrayType);
+        context.registerGlobalRoot(global, HeapKind::Array);
+        arraySlot = global;
+    }
+    else if (llvm::isa<llvm::AllocaInst>(data->stripInBoundsConstantOffsets()))
+    {
+        // Arrays on the stack are not the collector's business
+        arraySlot = context.builder.CreateAlloca(slotType, nullptr, name);
+    }
+    else
+    {
+        arraySlot = context.createRootSlot(slotType, name);
+    }
+    context.builder.CreateStore(data, arraySlot);
+    context.locals()[name] = {arraySlot, arrayType};
+    return arraySlot;
+}
+
 llvm::Value *ArrayDeclaration::codeGeneration(CodeGenContext &context)
 {
     llvm::Type *elementType;
@@ -391,36 +1315,114 @@ llvm::Value *ArrayDeclaration::codeGeneration(CodeGenContext &context)
     case TokenType::CHAR:
         elementType = llvm::Type::getInt8Ty(context.llvmContext); // 8-bit integer
         break;
-    case TokenType::STR:
-        elementType = llvm::PointerType::getInt8Ty(context.llvmContext);
-        break;
     default:
+        // Arrays are not roots, so their elements cannot refer to strings on the heap
         std::cerr << "Unsupported array type." << "\n";
         return nullptr;
     }
-    llvm::ArrayType *arrayType = llvm::ArrayType::get(elementType, size);
-    llvm::AllocaInst *arrayAlloc = context.builder.CreateAlloca(arrayType, nullptr, identifier->value);
-    context.locals()[identifier->value] = {arrayAlloc, arrayType};
+    llvm::Type *arrayType = arrayMarkerType(elementType);
 
-    if (!initValues.empty())
+    if (source)
     {
-        for (size_t i = 0; i < initValues.size(); ++i)
+        llvm::Value *data = createArrayValue(context, source.get(), arrayType, "Value of " + identifier->value);
+        if (!data)
+            return nullptr;
+        return createArraySlot(context, identifier->value, arrayType, data);
+    }
+
+    llvm::Value *length = size->codeGeneration(context);
+    if (!length)
+        return nullptr;
+    if (!length->getType()->isIntegerTy() || isBignum(length->getType()))
+    {
+        std::cerr << "Size of " << identifier->value << " must be an integer." << "\n";
+        return nullptr;
+    }
+    length = context.builder.CreateIntCast(length, context.builder.getInt64Ty(),
+                                           !length->getType()->isIntegerTy(1), "length");
+
+    // As stored in ArrayInfo, 0 for bitsets
+    uint64_t elementSize = isBitArray(elementType) ? 0 : context.module->getDataLayout().getTypeAllocSize(elementType).getFixedValue();
+    llvm::ConstantInt *constantLength = llvm::dyn_cast<llvm::ConstantInt>(length);
+    if (constantLength && constantLength->isNegative())
+    {
+        std::cerr << "Size requires positive int value" << "\n";
+        return nullptr;
+    }
+
+    if (constantLength && constantLength->getZExtValue() < initValues.size())
+    {
+        std::cerr << "Too many initializers for " << identifier->value << "." << "\n";
+        return nullptr;
+    }
+
+    // Globals are reachable from later inputs, so only locals may use the
+    // stack, and only those VisitorEscapeAnalysis proved are never returned
+    llvm::Value *data;
+    if (constantLength && !context.isGlobalScope() && !escapes &&
+        constantLength->getZExtValue() <= MaxStackArrayBytes * 64 &&
+        ArrayInfo::dataSize(constantLength->getZExtValue(), elementSize) <= MaxStackArrayBytes)
+    {
+        data = createStackArray(context, identifier->value, constantLength->getZExtValue(), elementSize);
+        context.countArrayAllocation(this, true);
+    }
+    else
+    {
+        if (!context.isGlobalScope())
+            context.countArrayAllocation(this, false);
+        llvm::FunctionCallee arrayNew = context.module->getOrInsertFunction(
+            "dnm_array_new",
+            llvm::PointerType::get(context.builder.getInt8Ty(), 0),
+            context.builder.getInt64Ty(), context.builder.getInt64Ty());
+        data = context.builder.CreateCall(arrayNew, {length, context.builder.getInt64(elementSize)}, identifier->value + "_data");
+    }
+
+    llvm::Value *arraySlot = createArraySlot(context, identifier->value, arrayType, data);
+
+    if (!constantInit.empty())
+    {
+        size_t entrySize = constantInit.size() / initValues.size();
+        // Only a list of exactly one literal fills the array
+        bool uniform = initValues.size() == 1;
+        createConstantInitializer(context, identifier->value, constantInit, entrySize, uniform, data, length, elementSize);
+    }
+
+    for (size_t i = 0; i < initValues.size(); ++i)
+    {
+        if (!initValues[i])
+            continue;
+        llvm::Value *initValue = initValues[i]->codeGeneration(context);
+        if (!initValue)
+            return nullptr;
+        initValue = toElementType(context, initValue, elementType, identifier->value);
+        if (!initValue)
+            return nullptr;
+        if (mayCollect(initValues[i].get()))
         {
-            llvm::Value *initValue = initValues[i]->codeGeneration(context);
-            llvm::Value *index = context.builder.getInt32(i);
+            data = context.builder.CreateLoad(data->getType(), arraySlot, identifier->value + "_data");
+        }
 
-            // Get pointer to the array element
-            llvm::Value *elementPtr = context.builder.CreateInBoundsGEP(
-                arrayType,
-                arrayAlloc,
-                {context.builder.getInt32(0), index},
-                identifier->value + "_elem_ptr");
+        // With a size known only at run time, entries past the end are dropped
+        llvm::BasicBlock *nextBlock = nullptr;
+        if (!constantLength)
+        {
+            llvm::Function *function = context.builder.GetInsertBlock()->getParent();
+            llvm::BasicBlock *storeBlock = llvm::BasicBlock::Create(context.llvmContext, "initStore", function);
+            nextBlock = llvm::BasicBlock::Create(context.llvmContext, "initNext", function);
+            context.builder.CreateCondBr(context.builder.CreateICmpUGT(length, context.builder.getInt64(i)), storeBlock, nextBlock);
+            context.builder.SetInsertPoint(storeBlock);
+        }
 
-            context.builder.CreateStore(initValue, elementPtr);
+        ArrayElement element = createArrayElement(context, elementType, data, context.builder.getInt64(i), identifier->value);
+        storeArrayElement(context, element, initValue);
+        if (nextBlock)
+        {
+            context.builder.CreateBr(nextBlock);
+            context.builder.SetInsertPoint(nextBlock);
         }
     }
 
-    return arrayAlloc;
+    return arraySlot;
 }
 
 llvm::Value *VariableDeclaration::codeGeneration(CodeGenContext &context)
@@ -430,27 +1432,31 @@ llvm::Value *VariableDeclaration::codeGeneration(CodeGenContext &context)
     {
     case TokenType::INT:
         varType = llvm::Type::getInt32Ty(context.llvmContext);
-        std::cout << "Assigned type - int32" << "\n";
+        DNM_LOG(CODEGEN, TRACE) << "Assigned type - int32";
         break;
     case TokenType::BIGINT: // 128 bit
         varType = llvm::Type::getInt128Ty(context.llvmContext);
-        std::cout << "Assigned type - int128" << "\n";
+        DNM_LOG(CODEGEN, TRACE) << "Assigned type - int128";
+        break;
+    case TokenType::BIGNUM: // tagged word, see Bignum.h
+        varType = llvm::Type::getInt64Ty(context.llvmContext);
+        DNM_LOG(CODEGEN, TRACE) << "Assigned type - bignum";
         break;
     case TokenType::FLOAT:
         varType = llvm::Type::getFloatTy(context.llvmContext);
-        std::cout << "Assigned type - float" << "\n";
+        DNM_LOG(CODEGEN, TRACE) << "Assigned type - float";
         break;
     case TokenType::CHAR:
         varType = llvm::Type::getInt8Ty(context.llvmContext);
-        std::cout << "Assigned type - char" << "\n";
+        DNM_LOG(CODEGEN, TRACE) << "Assigned type - char";
         break;
-    case TokenType::STR:
-        varType = llvm::PointerType::getInt8Ty(context.llvmContext);
-        std::cout << "Assigned type - str" << "\n";
+    case TokenType::STR: // tagged word, see Strings.h
+        varType = stringType(context);
+        DNM_LOG(CODEGEN, TRACE) << "Assigned type - str";
         break;
     case TokenType::BOOL:
         varType = llvm::Type::getInt1Ty(context.llvmContext);
-        std::cout << "Assigned type - boolean" << "\n";
+        DNM_LOG(CODEGEN, TRACE) << "Assigned type - boolean";
         break;
     }
 
@@ -460,13 +1466,67 @@ llvm::Value *VariableDeclaration::codeGeneration(CodeGenContext &context)
         return nullptr;
     }
 
-    llvm::AllocaInst *allocaInst = context.builder.CreateAlloca(varType, nullptr, identifier->value);
+    // An all-zero bignum or string word would be a null reference; zero is
+    // the inline word 1, and so is the empty string
+    bool heapValue = isBignum(varType) || isString(varType);
+    llvm::Constant *zeroValue = isBignum(varType)   ? llvm::ConstantInt::get(varType, 1)
+                                : isString(varType) ? llvm::ConstantExpr::getIntToPtr(context.builder.getInt64(1), varType)
+                                                    : llvm::Constant::getNullValue(varType);
+
+    llvm::Value *allocaInst;
+    if (context.isGlobalScope())
+    {
+        auto global = new llvm::GlobalVariable(*context.module, varType, false, llvm::GlobalValue::ExternalLinkage,
+                                               zeroValue, identifier->value);
+        context.declareGlobal(identifier->value, varType);
+        if (heapValue)
+        {
+            context.registerGlobalRoot(global, isBignum(varType) ? HeapKind::Bignum : HeapKind::String);
+        }
+        allocaInst = global;
+    }
+    else
+    {
+        allocaInst = heapValue ? context.createRootSlot(varType, identifier->value)
+                               : context.builder.CreateAlloca(varType, nullptr, identifier->value);
+        if (!initValue && heapValue)
+        {
+            context.builder.CreateStore(zeroValue, allocaInst);
+        }
+    }
 
     if (initValue)
     {
         llvm::Value *initVal = initValue->codeGeneration(context);
+        if (!initVal)
+        {
+            return nullptr;
+        }
 
-        if (initVal->getType() != varType)
+        if (isBignum(varType))
+        {
+            initVal = toBignum(context, initVal);
+            if (!initVal)
+            {
+                return nullptr;
+            }
+            shareValue(context, initValue.get(), initVal);
+        }
+        else if (isString(varType))
+        {
+            initVal = toStringValue(context, initVal);
+            if (!initVal)
+            {
+                return nullptr;
+            }
+            shareValue(context, initValue.get(), initVal);
+        }
+        else if (isBignum(initVal->getType()))
+        {
+            std::cerr << "Cannot initialize " << identifier->value << " from a bignum" << "\n";
+            return nullptr;
+        }
+        else if (initVal->getType() != varType)
         {
             if (varType->isIntegerTy() && initVal->getType()->isIntegerTy())
             {
@@ -493,69 +1553,150 @@ llvm::Value *VariableDeclaration::codeGeneration(CodeGenContext &context)
 
     context.locals()[identifier->value] = {allocaInst, varType};
 
-    context.getGCManager().addRoot(this);
     return allocaInst;
 }
 
-llvm::Value *Assignment::codeGeneration(CodeGenContext &context)
+// `acc = acc op x` updates the number in acc in place when acc owns it, so
+// accumulating loops do not leave a new number behind on every iteration
+static llvm::Value *assignBignum(CodeGenContext &context, const std::string &name, llvm::Value *slot, Expression *value)
 {
-    std::string identifierName;
-    llvm::Value *varPtr;
-    llvm::Type *varType;
-    if (typeid(*identifier) == typeid(Identifier))
+    Binary *binary = dynamic_cast<Binary *>(value);
+    Identifier *target = binary ? dynamic_cast<Identifier *>(binary->leftOperand.get()) : nullptr;
+    TokenType op = binary ? binary->_operator.type : EQUAL;
+    if (target && target->value == name && (op == PLUS || op == MINUS || op == MULTIPLY))
     {
-        identifierName = dynamic_cast<Identifier *>(identifier.get())->value;
-        for (auto blockIt = context.blocks.rbegin(); blockIt != context.blocks.rend(); ++blockIt)
+        llvm::Value *current = context.builder.CreateLoad(context.builder.getInt64Ty(), slot, name);
+        llvm::Value *operand = binary->rightOperand->codeGeneration(context);
+        operand = operand ? toBignum(context, operand) : nullptr;
+        if (!operand)
         {
-            auto &locals = (*blockIt)->locals;
-            auto it = locals.find(identifierName);
-            if (it != locals.end())
-            {
-                varPtr = it->second.first;
-                varType = it->second.second;
-                break;
-            }
+            return nullptr;
         }
-        if (!varPtr)
+        if (mayCollect(binary->rightOperand.get()))
         {
-            std::cerr << "Undefined: " << identifierName << "\n";
-            return nullptr;
+            // The variable itself is a root, so the number may have moved
+            current = context.builder.CreateLoad(context.builder.getInt64Ty(), slot, name);
         }
+        llvm::Value *result = createBignumArithmetic(context, op, current, operand, slot);
+        context.builder.CreateStore(result, slot);
+        return result;
+    }
 
-        llvm::Value *exprValue = value->codeGeneration(context);
-        context.builder.CreateStore(exprValue, varPtr);
-        return exprValue;
+    llvm::Value *exprValue = value->codeGeneration(context);
+    exprValue = exprValue ? toBignum(context, exprValue) : nullptr;
+    if (!exprValue)
+    {
+        return nullptr;
     }
-    else if (typeid(*identifier) == typeid(ArrayAccess))
+    shareValue(context, value, exprValue);
+    context.builder.CreateStore(exprValue, slot);
+    return exprValue;
+}
+
+// `s = s + x` appends x to the string in s, in place when s owns it, so a
+// string built up in a loop is not copied over on every iteration. As
+// concatenation is associative, `s = s + x + y` appends x, then y; all of
+// them are evaluated first, in case they read s.
+static llvm::Value *assignString(CodeGenContext &context, const std::string &name, llvm::Value *slot, Expression *value)
+{
+    std::vector<Expression *> appended;
+    Expression *first = value;
+    while (Binary *binary = dynamic_cast<Binary *>(first))
+    {
+        if (binary->_operator.type != PLUS)
+        {
+            break;
+        }
+        appended.insert(appended.begin(), binary->rightOperand.get());
+        first = binary->leftOperand.get();
+    }
+    Identifier *target = dynamic_cast<Identifier *>(first);
+    if (target && target->value == name && !appended.empty())
     {
-        identifierName = dynamic_cast<ArrayAccess *>(identifier.get())->identifier->value;
-        for (auto blockIt = context.blocks.rbegin(); blockIt != context.blocks.rend(); ++blockIt)
+        std::vector<llvm::Value *> operands;
+        std::vector<llvm::AllocaInst *> kept(appended.size());
+        for (size_t i = 0; i < appended.size(); i++)
         {
-            auto &locals = (*blockIt)->locals;
-            auto it = locals.find(identifierName);
-            if (it != locals.end())
+            llvm::Value *operand = appended[i]->codeGeneration(context);
+            operand = operand ? toStringValue(context, operand) : nullptr;
+            if (!operand)
             {
-                varPtr = it->second.first;
-                varType = it->second.second;
-                break;
+                return nullptr;
+            }
+            for (size_t later = i + 1; later < appended.size() && !kept[i]; later++)
+            {
+                kept[i] = keepAcross(context, operand, appended[later]);
             }
+            operands.push_back(operand);
         }
+        llvm::Type *type = stringType(context);
+        llvm::FunctionType *appendType = llvm::FunctionType::get(
+            context.builder.getVoidTy(), {llvm::PointerType::get(type, 0), type}, false);
+        llvm::FunctionCallee append = context.module->getOrInsertFunction("dnm_str_append", appendType);
+        for (size_t i = 0; i < operands.size(); i++)
+        {
+            context.builder.CreateCall(append, {slot, readBack(context, operands[i], kept[i])});
+        }
+        return context.builder.CreateLoad(type, slot, name);
+    }
+
+    llvm::Value *exprValue = value->codeGeneration(context);
+    exprValue = exprValue ? toStringValue(context, exprValue) : nullptr;
+    if (!exprValue)
+    {
+        return nullptr;
+    }
+    shareValue(context, value, exprValue);
+    context.builder.CreateStore(exprValue, slot);
+    return exprValue;
+}
+
+llvm::Value *Assignment::codeGeneration(CodeGenContext &context)
+{
+    std::string identifierName;
+    llvm::Value *varPtr;
+    llvm::Type *varType;
+    if (typeid(*identifier) == typeid(Identifier))
+    {
+        identifierName = dynamic_cast<Identifier *>(identifier.get())->value;
+        std::tie(varPtr, varType) = context.lookupVariable(identifierName);
         if (!varPtr)
         {
             std::cerr << "Undefined: " << identifierName << "\n";
             return nullptr;
         }
 
-        llvm::Value *indexValue = dynamic_cast<ArrayAccess *>(identifier.get())->index->codeGeneration(context);
+        if (varType->isArrayTy())
+        {
+            std::cerr << "Cannot assign to array " << identifierName << "; assign its elements." << "\n";
+            return nullptr;
+        }
 
-        llvm::Value *elementPtr = context.builder.CreateGEP(
-            varType,
-            varPtr,
-            {context.builder.getInt32(0), indexValue},
-            "elementPtr");
+        if (isBignum(varType))
+        {
+            return assignBignum(context, identifierName, varPtr, value.get());
+        }
+        if (isString(varType))
+        {
+            return assignString(context, identifierName, varPtr, value.get());
+        }
 
         llvm::Value *exprValue = value->codeGeneration(context);
-        context.builder.CreateStore(exprValue, elementPtr);
+        context.builder.CreateStore(exprValue, varPtr);
+        return exprValue;
+    }
+    else if (typeid(*identifier) == typeid(ArrayAccess))
+    {
+        ArrayAccess *access = dynamic_cast<ArrayAccess *>(identifier.get());
+        ArrayElement element;
+        llvm::Value *exprValue;
+        if (!createElementReference(context, *access, element, value.get(), &exprValue))
+            return nullptr;
+        exprValue = toElementType(context, exprValue, element.type, access->identifier->value);
+        if (!exprValue)
+            return nullptr;
+
+        storeArrayElement(context, element, exprValue);
 
         return exprValue;
     }
@@ -586,52 +1727,64 @@ llvm::Value *Assignment::codeGeneration(CodeGenContext &context)
 
 llvm::Value *Print::codeGeneration(CodeGenContext &context)
 {
-    std::cout << "Print AST Node" << "\n";
+    DNM_LOG(CODEGEN, TRACE) << "Print AST Node";
     llvm::Value *value = expr->codeGeneration(context);
     if (!value)
     {
         return nullptr;
     }
 
+    // Each type has its own writer in the runtime (Runtime.h), which saves
+    // parsing a format string for every printed value
     llvm::Type *valueType = value->getType();
-    llvm::FunctionType *printfType = llvm::FunctionType::get(
-        context.builder.getInt32Ty(),
-        llvm::PointerType::get(context.builder.getInt8Ty(), 0),
-        true);
-
-    llvm::FunctionCallee printfFunc = context.module->getOrInsertFunction("printf", printfType);
-
-    llvm::Value *formatStr = nullptr;
+    const char *writerName = nullptr;
     if (valueType->isIntegerTy(32))
     {
-        formatStr = context.builder.CreateGlobalStringPtr("%d\n", "formatStr");
+        writerName = "dnm_print_i32";
+    }
+    else if (isBignum(valueType))
+    {
+        writerName = "dnm_print_big";
     }
     else if (valueType->isIntegerTy(128))
     {
-        formatStr = context.builder.CreateGlobalStringPtr("%lld\n", "formatStr");
+        // Passed as two 64-bit halves, see Runtime.h
+        llvm::Type *int64Type = context.builder.getInt64Ty();
+        llvm::FunctionType *writerType = llvm::FunctionType::get(
+            context.builder.getVoidTy(), {int64Type, int64Type}, false);
+        llvm::FunctionCallee writer = context.module->getOrInsertFunction("dnm_print_i128", writerType);
+        llvm::Value *low = context.builder.CreateTrunc(value, int64Type);
+        llvm::Value *high = context.builder.CreateTrunc(context.builder.CreateLShr(value, 64), int64Type);
+        return context.builder.CreateCall(writer, {low, high});
     }
     else if (valueType->isFloatingPointTy())
     {
-        formatStr = context.builder.CreateGlobalStringPtr("%f\n", "formatStr");
+        writerName = "dnm_print_f64";
+        value = context.builder.CreateFPExt(value, context.builder.getDoubleTy());
     }
     else if (valueType->isIntegerTy(1))
     {
-        formatStr = context.builder.CreateGlobalStringPtr("%d\n", "formatStr");
+        writerName = "dnm_print_i32";
+        value = context.builder.CreateZExt(value, context.builder.getInt32Ty());
     }
     else if (valueType->isIntegerTy(8))
     {
-        formatStr = context.builder.CreateGlobalStringPtr("%c\n", "formatStr");
+        writerName = "dnm_print_char";
+        value = context.builder.CreateZExt(value, context.builder.getInt32Ty());
     }
-    else if (valueType->isPointerTy())
+    else if (isString(valueType))
     {
-        formatStr = context.builder.CreateGlobalStringPtr("%s\n", "formatStr");
+        writerName = "dnm_print_str";
     }
     else
     {
         return nullptr;
     }
 
-    return context.builder.CreateCall(printfFunc, {formatStr, value}, "printCall");
+    llvm::FunctionType *writerType = llvm::FunctionType::get(
+        context.builder.getVoidTy(), {value->getType()}, false);
+    llvm::FunctionCallee writer = context.module->getOrInsertFunction(writerName, writerType);
+    return context.builder.CreateCall(writer, {value});
 };
 
 llvm::Value *Block::codeGeneration(CodeGenContext &context)
@@ -655,27 +1808,17 @@ llvm::Value *Block::codeGeneration(CodeGenContext &context)
 
 llvm::Value *Condition::codeGeneration(CodeGenContext &context)
 {
-    llvm::Value *condition = conditionExpr->codeGeneration(context);
-    if (!condition)
-    {
-        std::cerr << "Failed to generate condition expression." << "\n";
-        return nullptr;
-    }
-
-    if (!condition->getType()->isIntegerTy(1))
-    {
-        condition = context.builder.CreateICmpNE(
-            condition,
-            llvm::ConstantInt::get(condition->getType(), 0),
-            "ifcond");
-    }
     llvm::Function *currFunc = context.builder.GetInsertBlock()->getParent();
 
     llvm::BasicBlock *thenBl = llvm::BasicBlock::Create(context.llvmContext, "then", currFunc);
     llvm::BasicBlock *elseBl = llvm::BasicBlock::Create(context.llvmContext, "else", currFunc);
     llvm::BasicBlock *mergeBl = llvm::BasicBlock::Create(context.llvmContext, "ifcont", currFunc);
 
-    context.builder.CreateCondBr(condition, thenBl, elseBl);
+    if (!createConditionBranch(context, conditionExpr.get(), thenBl, elseBl))
+    {
+        std::cerr << "Failed to generate condition expression." << "\n";
+        return nullptr;
+    }
 
     context.builder.SetInsertPoint(thenBl);
     llvm::Value *thenV = ifBlock->codeGeneration(context);
@@ -721,11 +1864,119 @@ llvm::Value *Condition::codeGeneration(CodeGenContext &context)
     return mergeBl;
 }
 
+// Polls for a collection at the end of a loop iteration. Only calls allocate,
+// so loops that make none skip the poll. The blocks of a loop are the ones
+// created since its header.
+static void createLoopSafepoint(CodeGenContext &context, llvm::BasicBlock *loopHeader)
+{
+    llvm::Function *function = loopHeader->getParent();
+    bool calls = false;
+    for (auto block = loopHeader->getIterator(); block != function->end() && !calls; ++block)
+    {
+        for (auto &instruction : *block)
+        {
+            auto call = llvm::dyn_cast<llvm::CallInst>(&instruction);
+            if (call && !call->doesNotReturn() && !llvm::isa<llvm::IntrinsicInst>(call))
+            {
+                calls = true;
+                break;
+            }
+        }
+    }
+    if (calls)
+    {
+        context.createSafepoint();
+    }
+}
+
+// Emits the header, body and update of a for loop starting at loopHeader
+static bool createLoopIterations(CodeGenContext &context, ForLoop &loop, llvm::BasicBlock *loopHeader, llvm::BasicBlock *loopEnd)
+{
+    llvm::Function *function = loopHeader->getParent();
+    llvm::BasicBlock *loopBody = llvm::BasicBlock::Create(context.llvmContext, "loopBody", function);
+
+    context.builder.SetInsertPoint(loopHeader);
+    if (!loop.condition)
+    {
+        context.builder.CreateBr(loopBody);
+    }
+    else if (!createConditionBranch(context, loop.condition.get(), loopBody, loopEnd))
+    {
+        return false;
+    }
+
+    context.builder.SetInsertPoint(loopBody);
+    if (loop.body)
+    {
+        loop.body->codeGeneration(context);
+    }
+
+    if (loop.update)
+    {
+        loop.update->codeGeneration(context);
+    }
+
+    createLoopSafepoint(context, loopHeader);
+    context.builder.CreateBr(loopHeader);
+    return true;
+}
+
+// Tests the hoisted bounds checks of a loop once, before its first iteration.
+// The loop variable runs from its initial value up to the limit, so an access
+// at v + c is safe in every iteration when it is safe at both ends. Returns
+// nullptr when the limit cannot be evaluated up front.
+static llvm::Value *createHoistedChecks(CodeGenContext &context, ForLoop &loop)
+{
+    llvm::IRBuilder<> &builder = context.builder;
+    auto declaration = dynamic_cast<VariableDeclaration *>(loop.initializer.get());
+    auto comparison = dynamic_cast<Comparison *>(loop.condition.get());
+    const std::string &name = declaration->identifier->value;
+    auto counter = context.lookupVariable(name);
+    if (!counter.first || !counter.second->isIntegerTy(32))
+        return nullptr;
+    // Looked up before any IR is emitted, so giving up leaves nothing behind
+    std::vector<std::pair<llvm::Value *, int64_t>> arrays;
+    for (auto &[access, offset] : loop.hoistedChecks)
+    {
+        auto array = context.lookupVariable(access->identifier->value);
+        if (!array.first || !array.second->isArrayTy())
+            return nullptr;
+        arrays.emplace_back(array.first, offset);
+    }
+
+    llvm::Value *limit = comparison->rightOperand->codeGeneration(context);
+    if (!limit || !limit->getType()->isIntegerTy(32))
+        return nullptr;
+
+    llvm::Value *first = builder.CreateSExt(builder.CreateLoad(counter.second, counter.first, name), builder.getInt64Ty(), name + "_first");
+    llvm::Value *last = builder.CreateSExt(limit, builder.getInt64Ty(), name + "_last");
+    if (comparison->_operator.type == LESS)
+        last = builder.CreateSub(last, builder.getInt64(1), name + "_last");
+
+    // Every access must be in bounds for the unchecked copy to run
+    llvm::Value *safe = builder.getTrue();
+    for (size_t i = 0; i < arrays.size(); ++i)
+    {
+        const std::string &arrayName = loop.hoistedChecks[i].first->identifier->value;
+        int64_t offset = arrays[i].second;
+        llvm::Value *data = builder.CreateLoad(llvm::PointerType::get(builder.getInt8Ty(), 0), arrays[i].first, arrayName + "_data");
+        llvm::Value *length = loadArrayLength(context, data, arrayName);
+        llvm::Value *lowest = builder.CreateAdd(first, builder.getInt64(offset));
+        llvm::Value *highest = builder.CreateAdd(last, builder.getInt64(offset));
+        // The index is computed in 32 bits, so it must not wrap either
+        llvm::Value *fits = builder.CreateAnd(builder.CreateICmpSGE(lowest, builder.getInt64(0)),
+                                              builder.CreateICmpSLE(highest, builder.getInt64(INT32_MAX)));
+        llvm::Value *inBounds = builder.CreateAnd(fits, builder.CreateICmpSLT(highest, length), arrayName + "_hoisted_ok");
+        safe = builder.CreateAnd(safe, inBounds);
+    }
+    // A loop that does not run needs no checks
+    return builder.CreateOr(builder.CreateICmpSGT(first, last, name + "_no_iterations"), safe);
+}
+
 llvm::Value *ForLoop::codeGeneration(CodeGenContext &context)
 {
     llvm::Function *function = context.builder.GetInsertBlock()->getParent();
     llvm::BasicBlock *loopHeader = llvm::BasicBlock::Create(context.llvmContext, "loopHeader", function);
-    llvm::BasicBlock *loopBody = llvm::BasicBlock::Create(context.llvmContext, "loopBody", function);
     llvm::BasicBlock *loopEnd = llvm::BasicBlock::Create(context.llvmContext, "loopEnd", function);
 
     context.pushBlock(loopHeader);
@@ -735,34 +1986,38 @@ llvm::Value *ForLoop::codeGeneration(CodeGenContext &context)
         initializer->codeGeneration(context);
     }
 
-    context.builder.CreateBr(loopHeader);
-    context.builder.SetInsertPoint(loopHeader);
-
-    llvm::Value *condValue = condition->codeGeneration(context);
-    if (!condValue)
+    // With hoisted checks the loop is emitted twice: a copy without the
+    // checks, taken when they all pass up front, and the checked loop
+    llvm::Value *hoistedOk = nullptr;
+    if (context.boundsCheck && !hoistedChecks.empty())
+        hoistedOk = createHoistedChecks(context, *this);
+    if (hoistedOk)
     {
-        return nullptr;
+        llvm::BasicBlock *fastHeader = llvm::BasicBlock::Create(context.llvmContext, "loopHeaderUnchecked", function);
+        context.builder.CreateCondBr(hoistedOk, fastHeader, loopHeader);
+        for (auto &check : hoistedChecks)
+            check.first->inBounds = true;
+        bool generated = createLoopIterations(context, *this, fastHeader, loopEnd);
+        for (auto &check : hoistedChecks)
+            check.first->inBounds = false;
+        if (!generated)
+            return nullptr;
     }
-
-    context.builder.CreateCondBr(condValue, loopBody, loopEnd);
-
-    context.builder.SetInsertPoint(loopBody);
-    if (body)
+    else
     {
-        body->codeGeneration(context);
+        context.builder.CreateBr(loopHeader);
     }
 
-    if (update)
+    if (!createLoopIterations(context, *this, loopHeader, loopEnd))
     {
-        update->codeGeneration(context);
+        return nullptr;
     }
 
-    context.builder.CreateBr(loopHeader);
     context.builder.SetInsertPoint(loopEnd);
 
     context.popBlock();
 
-    return condValue; // dump value;
+    return loopEnd;
 }
 
 llvm::Value *WhileLoop::codeGeneration(CodeGenContext &context)
@@ -775,33 +2030,22 @@ llvm::Value *WhileLoop::codeGeneration(CodeGenContext &context)
 
     context.builder.CreateBr(condBlock);
     context.builder.SetInsertPoint(condBlock);
-    llvm::Value *condValue = condition->codeGeneration(context);
-    if (!condValue)
+    if (!createConditionBranch(context, condition.get(), bodyBlock, endBlock))
     {
         std::cerr << "Failed to generate condition for while loop" << "\n";
-    }
-
-    if (condValue->getType()->isIntegerTy() && condValue->getType()->getIntegerBitWidth() != 1)
-    {
-        condValue = context.builder.CreateICmpNE(condValue, context.builder.getInt32(0), "while.cond.bool");
-    }
-    else if (!condValue->getType()->isIntegerTy(1))
-    {
-        std::cerr << "Condition of while loop must be boolean" << "\n";
         return nullptr;
     }
-
-    context.builder.CreateCondBr(condValue, bodyBlock, endBlock);
     context.builder.SetInsertPoint(bodyBlock);
     llvm::Value *bodyValue = body->codeGeneration(context);
+    createLoopSafepoint(context, condBlock);
     context.builder.CreateBr(condBlock);
     context.builder.SetInsertPoint(endBlock);
-    return nullptr;
+    return endBlock;
 };
 
 llvm::Value *PrototypeFunction::codeGeneration(CodeGenContext &context)
 {
-    std::cout << "Prototype AST node" << "\n";
+    DNM_LOG(CODEGEN, TRACE) << "Prototype AST node " << name;
     std::vector<llvm::Type *> argTypes(args.size());
     for (int i = 0; i < args.size(); i++)
     {
@@ -813,11 +2057,14 @@ llvm::Value *PrototypeFunction::codeGeneration(CodeGenContext &context)
         case BIGINT:
             argTypes[i] = llvm::Type::getInt128Ty(context.llvmContext);
             break;
+        case BIGNUM:
+            argTypes[i] = llvm::Type::getInt64Ty(context.llvmContext);
+            break;
         case FLOAT:
             argTypes[i] = llvm::Type::getFloatTy(context.llvmContext);
             break;
         case STR:
-            argTypes[i] = llvm::PointerType::getInt8Ty(context.llvmContext);
+            argTypes[i] = stringType(context);
             break;
         case CHAR:
             argTypes[i] = llvm::Type::getInt8Ty(context.llvmContext);
@@ -828,6 +2075,22 @@ llvm::Value *PrototypeFunction::codeGeneration(CodeGenContext &context)
         }
     }
 
+    // Arrays are passed and returned as a pointer to their data, which their
+    // length precedes. arrayTypes records what the pointers are.
+    std::vector<llvm::Type *> arrayTypes(args.size() + 1);
+    for (int i = 0; i < args.size(); i++)
+    {
+        if (!arrayArgs[i])
+            continue;
+        if (args[i].first == BIGNUM || args[i].first == STR)
+        {
+            std::cerr << "Unsupported array type." << "\n";
+            return nullptr;
+        }
+        arrayTypes[i] = arrayMarkerType(argTypes[i]);
+        argTypes[i] = llvm::PointerType::get(context.builder.getInt8Ty(), 0);
+    }
+
     llvm::Type *retType = nullptr;
     switch (returnType)
     {
@@ -837,11 +2100,14 @@ llvm::Value *PrototypeFunction::codeGeneration(CodeGenContext &context)
     case BIGINT:
         retType = llvm::Type::getInt128Ty(context.llvmContext);
         break;
+    case BIGNUM:
+        retType = llvm::Type::getInt64Ty(context.llvmContext);
+        break;
     case FLOAT:
         retType = llvm::Type::getFloatTy(context.llvmContext);
         break;
     case STR:
-        retType = llvm::PointerType::getInt8Ty(context.llvmContext);
+        retType = stringType(context);
         break;
     case CHAR:
         retType = llvm::Type::getInt8Ty(context.llvmContext);
@@ -855,15 +2121,29 @@ llvm::Value *PrototypeFunction::codeGeneration(CodeGenContext &context)
     default:
         return nullptr;
     }
+    if (returnsArray)
+    {
+        if (returnType == VOID || returnType == BIGNUM || returnType == STR)
+        {
+            std::cerr << "Unsupported array type." << "\n";
+            return nullptr;
+        }
+        arrayTypes.back() = arrayMarkerType(retType);
+        retType = llvm::PointerType::get(context.builder.getInt8Ty(), 0);
+    }
 
-    std::cout << "Function args types are chosen" << "\n";
     llvm::FunctionType *funcType = llvm::FunctionType::get(retType, argTypes, false);
     
-    std::cout << "Create" << "\n";
+    if (context.lookupFunction(name))
+    {
+        std::cerr << "Function " << name << " is already defined" << "\n";
+        return nullptr;
+    }
+
     llvm::Function *func = llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, name, context.module.get());
+    context.declareFunction(name, funcType, arrayTypes);
 
 
-    std::cout << "Index" << "\n";
     unsigned index = 0;
     for (auto &arg : func->args())
         arg.setName(args[index++].second);
@@ -871,6 +2151,70 @@ llvm::Value *PrototypeFunction::codeGeneration(CodeGenContext &context)
     return func;
 }
 
+// Tells LLVM what the body does with its array parameters. Data pointers are
+// never null and 16-byte aligned. A parameter the body only reads is
+// readonly, and nocapture unless it is returned or passed on. It is noalias
+// when no other array the body can reach from outside is accessed through
+// it, or when neither is written, and the body makes no calls that could
+// reach arrays behind its back. A result that is always an array the body
+// created is noalias too.
+static void addArrayAttributes(CodeGenContext &context, llvm::Function &function, PrototypeFunction &prototype, Block &body)
+{
+    VisitorArrayUsage usage;
+    body.accept(usage);
+    std::set<std::string> parameters;
+    for (auto &arg : prototype.args)
+        parameters.insert(arg.second);
+
+    // Arrays that may be shared with the caller: parameters and globals
+    std::set<std::string> outside;
+    for (auto *names : {&usage.read, &usage.written})
+    {
+        for (auto &name : *names)
+        {
+            if (parameters.count(name) || !usage.declared.count(name))
+                outside.insert(name);
+        }
+    }
+
+    for (auto &arg : function.args())
+    {
+        const std::string &name = prototype.args[arg.getArgNo()].second;
+        if (!prototype.arrayArgs[arg.getArgNo()])
+            continue;
+        arg.addAttr(llvm::Attribute::NonNull);
+        arg.addAttr(llvm::Attribute::getWithAlignment(context.llvmContext, llvm::Align(16)));
+        // What the body does through an array bound to the parameter, it does to the parameter
+        bool passed = usage.usedAs(usage.passed, name);
+        bool writes = usage.usedAs(usage.written, name) || passed;
+        if (!writes)
+            arg.addAttr(llvm::Attribute::ReadOnly);
+        if (!passed && !usage.usedAs(usage.returned, name))
+            arg.addAttr(llvm::Attribute::NoCapture);
+
+        bool noAlias = !usage.hasCall;
+        for (auto &other : outside)
+        {
+            if (other != name && (writes || usage.written.count(other)))
+                noAlias = false;
+        }
+        if (noAlias)
+            arg.addAttr(llvm::Attribute::NoAlias);
+    }
+
+    if (prototype.returnsArray && !usage.returnsExpression && !usage.returned.empty())
+    {
+        bool fresh = true;
+        for (auto &name : usage.returned)
+        {
+            if (!usage.declared.count(name) || usage.bound.count(name) || parameters.count(name))
+                fresh = false;
+        }
+        if (fresh)
+            function.addRetAttr(llvm::Attribute::NoAlias);
+    }
+}
+
 llvm::Value *FunctionNode::codeGeneration(CodeGenContext &context)
 {
     llvm::Function *function = static_cast<llvm::Function *>(prototype->codeGeneration(context));
@@ -888,7 +2232,10 @@ llvm::Value *FunctionNode::codeGeneration(CodeGenContext &context)
     {
         llvm::Type *expectedArgType = arg.getType();
         llvm::Value *argValue = &arg;
-        llvm::AllocaInst *alloc = context.builder.CreateAlloca(expectedArgType, nullptr, arg.getName());
+        // Collections may move bignums, strings and arrays, so the callee needs its own root for them
+        bool heapValue = isBignum(expectedArgType) || isString(expectedArgType) || prototype->arrayArgs[arg.getArgNo()];
+        llvm::AllocaInst *alloc = heapValue ? context.createRootSlot(expectedArgType, arg.getName().str())
+                                            : context.builder.CreateAlloca(expectedArgType, nullptr, arg.getName());
 
         if (argValue->getType() != expectedArgType)
         {
@@ -930,8 +2277,11 @@ llvm::Value *FunctionNode::codeGeneration(CodeGenContext &context)
         }
         context.builder.CreateStore(&arg, alloc);
 
-        context.locals()[arg.getName().str()] = {alloc, arg.getType()};
+        llvm::Type *arrayType = context.functionArrayType(prototype->name, arg.getArgNo());
+        context.locals()[arg.getName().str()] = {alloc, arrayType ? arrayType : arg.getType()};
     }
+    llvm::Instruction *prologueEnd = block->empty() ? nullptr : &block->back();
+    addArrayAttributes(context, *function, *prototype, *bodyBlock);
 
     llvm::Value *returnValue = bodyBlock->codeGeneration(context);
     if (!returnValue && prototype->returnType != VOID)
@@ -946,12 +2296,24 @@ llvm::Value *FunctionNode::codeGeneration(CodeGenContext &context)
     }
 
     context.popBlock();
+    context.createRootFrame(function, prologueEnd);
+    context.finishFunction(function);
     llvm::verifyFunction(*function);
     return function;
 }
 
 llvm::Value *Return::codeGeneration(CodeGenContext &context)
 {
+    llvm::Function *function = context.builder.GetInsertBlock()->getParent();
+    if (llvm::Type *arrayType = context.functionArrayType(function->getName().str(), function->arg_size()))
+    {
+        llvm::Value *data = createArrayValue(context, expr.get(), arrayType, "Return value of " + function->getName().str());
+        if (!data)
+            return nullptr;
+        context.builder.CreateRet(data);
+        return data;
+    }
+
     llvm::Value *returnValue = expr->codeGeneration(context);
     if (!returnValue)
     {
@@ -967,7 +2329,30 @@ llvm::Value *Return::codeGeneration(CodeGenContext &context)
     }
 
     llvm::Type *returnType = currentFunction->getReturnType();
-    if (returnType != returnValue->getType())
+    if (isBignum(returnType))
+    {
+        returnValue = toBignum(context, returnValue);
+        if (!returnValue)
+        {
+            return nullptr;
+        }
+        shareValue(context, expr.get(), returnValue);
+    }
+    else if (isString(returnType))
+    {
+        returnValue = toStringValue(context, returnValue);
+        if (!returnValue)
+        {
+            return nullptr;
+        }
+        shareValue(context, expr.get(), returnValue);
+    }
+    else if (isBignum(returnValue->getType()))
+    {
+        std::cerr << "Cannot return a bignum from a function of a narrower type" << std::endl;
+        return nullptr;
+    }
+    else if (returnType != returnValue->getType())
     {
         if (returnType->isIntegerTy() && returnValue->getType()->isIntegerTy())
         {
@@ -0,0 +1,56 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "include/Array.h"
+#include "include/GCBackend.h"
+#include "include/Runtime.h"
+
+void *dnm_array_new(int64_t length, int64_t elementSize){
+    static_assert(sizeof(ArrayInfo) % 16 == 0, "array data must stay 16-byte aligned");
+    GCBackend *backend = GCBackend::current();
+    if (!backend){
+        std::cerr << "array allocated outside of a running program\n";
+        runtimeError();
+    }
+    int64_t limit = (INT64_MAX - int64_t(sizeof(ArrayInfo)) - 63) / std::max<int64_t>(elementSize, 1);
+    if (length < 0 || length > limit){
+        std::cerr << "Invalid array length " << length << "\n";
+        runtimeError();
+    }
+    ArrayInfo *info = static_cast<ArrayInfo *>(
+        backend->allocate(HeapKind::Array, sizeof(ArrayInfo) + ArrayInfo::dataSize(length, elementSize)));
+    info->elementSize = elementSize;
+    info->length = length;
+    return info + 1;
+}
+
+void dnm_array_fill(void *data, const void *value){
+    ArrayInfo *info = ArrayInfo::of(data);
+    size_t total = ArrayInfo::dataSize(info->length, info->elementSize);
+    if (total == 0){
+        return;
+    }
+    if (info->elementSize == 0){
+        // Whole words at a time, with the bits past the end kept clear
+        uint64_t *words = static_cast<uint64_t *>(data);
+        memset(words, *static_cast<const uint8_t *>(value) ? 0xFF : 0, total);
+        if (info->length % 64){
+            words[info->length / 64] &= (uint64_t(1) << (info->length % 64)) - 1;
+        }
+        return;
+    }
+    // Each copy doubles the filled prefix, so a fill is O(log n) memcpy calls
+    uint8_t *bytes = static_cast<uint8_t *>(data);
+    memcpy(bytes, value, info->elementSize);
+    for (size_t filled = info->elementSize; filled < total; filled *= 2){
+        memcpy(bytes + filled, bytes, std::min(filled, total - filled));
+    }
+}
+
+void dnm_array_index_error(const char *name, int64_t index, int64_t length){
+    // Whatever the program printed so far comes before the error
+    flushOutput();
+    std::cerr << "Index " << index << " out of bounds for array " << name << " of length " << length << "\n";
+    runtimeError();
+}
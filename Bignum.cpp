@@ -0,0 +1,457 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "include/Bignum.h"
+#include "include/GCBackend.h"
+#include "include/Runtime.h"
+
+typedef std::vector<uint64_t> Limbs;
+
+static const void *const SharedOwner = &SharedOwner;
+
+// Inline values cover [-2^62, 2^62 - 1]
+static const uint64_t SmallLimit = uint64_t(1) << 62;
+
+// Below this many limbs Karatsuba's extra additions cost more than they save
+static const size_t KaratsubaThreshold = 32;
+
+static bool isSmall(int64_t value){
+    return value & 1;
+}
+
+static int64_t smallValue(int64_t value){
+    return value >> 1;
+}
+
+static int64_t tagSmall(int64_t value){
+    return static_cast<int64_t>((static_cast<uint64_t>(value) << 1) | 1);
+}
+
+static BigNum *heapNumber(int64_t value){
+    return reinterpret_cast<BigNum *>(value);
+}
+
+// Sign and magnitude of a value, whether inline or on the heap
+struct Operand {
+    bool negative;
+    const uint64_t *limbs;
+    size_t length;
+    uint64_t inlineLimb;
+
+    explicit Operand(int64_t value){
+        if (isSmall(value)){
+            int64_t small = smallValue(value);
+            negative = small < 0;
+            inlineLimb = negative ? 0 - static_cast<uint64_t>(small) : static_cast<uint64_t>(small);
+            limbs = &inlineLimb;
+            length = inlineLimb ? 1 : 0;
+        } else {
+            BigNum *number = heapNumber(value);
+            negative = number->negative;
+            limbs = number->limbs();
+            length = number->length;
+        }
+    }
+    Operand(const Operand &) = delete;
+    Operand &operator=(const Operand &) = delete;
+};
+
+static size_t trimmedLength(const uint64_t *limbs, size_t length){
+    while (length > 0 && limbs[length - 1] == 0){
+        length--;
+    }
+    return length;
+}
+
+static int compareMagnitude(const uint64_t *a, size_t n, const uint64_t *b, size_t m){
+    if (n != m){
+        return n < m ? -1 : 1;
+    }
+    for (size_t i = n; i-- > 0;){
+        if (a[i] != b[i]){
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// out = a + b, out has room for max(n, m) + 1 limbs; returns the length used
+static size_t addMagnitude(const uint64_t *a, size_t n, const uint64_t *b, size_t m, uint64_t *out){
+    if (n < m){
+        std::swap(a, b);
+        std::swap(n, m);
+    }
+    unsigned __int128 carry = 0;
+    for (size_t i = 0; i < n; i++){
+        carry += a[i];
+        if (i < m){
+            carry += b[i];
+        }
+        out[i] = static_cast<uint64_t>(carry);
+        carry >>= 64;
+    }
+    out[n] = static_cast<uint64_t>(carry);
+    return n + 1;
+}
+
+// out = a - b where a >= b, out has room for n limbs
+static void subtractMagnitude(const uint64_t *a, size_t n, const uint64_t *b, size_t m, uint64_t *out){
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < n; i++){
+        uint64_t subtrahend = i < m ? b[i] : 0;
+        uint64_t difference = a[i] - subtrahend - borrow;
+        borrow = (a[i] < subtrahend || (a[i] == subtrahend && borrow)) ? 1 : 0;
+        out[i] = difference;
+    }
+}
+
+// out[shift...] += a, out must be long enough to absorb the carry
+static void addShifted(uint64_t *out, size_t outLength, const uint64_t *a, size_t n, size_t shift){
+    unsigned __int128 carry = 0;
+    size_t i = 0;
+    for (; i < n; i++){
+        carry += static_cast<unsigned __int128>(out[shift + i]) + a[i];
+        out[shift + i] = static_cast<uint64_t>(carry);
+        carry >>= 64;
+    }
+    for (size_t j = shift + i; carry && j < outLength; j++){
+        carry += out[j];
+        out[j] = static_cast<uint64_t>(carry);
+        carry >>= 64;
+    }
+}
+
+// out = a * b, out has n + m zeroed limbs
+static void multiplySchoolbook(const uint64_t *a, size_t n, const uint64_t *b, size_t m, uint64_t *out){
+    for (size_t i = 0; i < n; i++){
+        unsigned __int128 carry = 0;
+        for (size_t j = 0; j < m; j++){
+            carry += static_cast<unsigned __int128>(a[i]) * b[j] + out[i + j];
+            out[i + j] = static_cast<uint64_t>(carry);
+            carry >>= 64;
+        }
+        out[i + m] = static_cast<uint64_t>(carry);
+    }
+}
+
+static void multiplyMagnitude(const uint64_t *a, size_t n, const uint64_t *b, size_t m, uint64_t *out);
+
+// a = a0 + a1 * B^half, b likewise:
+// a * b = z0 + ((a0 + a1)(b0 + b1) - z0 - z2) * B^half + z2 * B^(2 half)
+static void multiplyKaratsuba(const uint64_t *a, size_t n, const uint64_t *b, size_t m, uint64_t *out){
+    size_t half = n / 2;
+    const uint64_t *a0 = a, *a1 = a + half;
+    const uint64_t *b0 = b, *b1 = b + half;
+    size_t a0Length = trimmedLength(a0, half), a1Length = n - half;
+    size_t b0Length = trimmedLength(b0, half), b1Length = m - half;
+
+    Limbs z0(a0Length + b0Length, 0);
+    multiplyMagnitude(a0, a0Length, b0, b0Length, z0.data());
+    Limbs z2(a1Length + b1Length, 0);
+    multiplyMagnitude(a1, a1Length, b1, b1Length, z2.data());
+
+    Limbs aSum(std::max(a0Length, a1Length) + 1), bSum(std::max(b0Length, b1Length) + 1);
+    size_t aSumLength = trimmedLength(aSum.data(), addMagnitude(a0, a0Length, a1, a1Length, aSum.data()));
+    size_t bSumLength = trimmedLength(bSum.data(), addMagnitude(b0, b0Length, b1, b1Length, bSum.data()));
+    Limbs z1(aSumLength + bSumLength, 0);
+    multiplyMagnitude(aSum.data(), aSumLength, bSum.data(), bSumLength, z1.data());
+
+    size_t z1Length = trimmedLength(z1.data(), z1.size());
+    subtractMagnitude(z1.data(), z1Length, z0.data(), trimmedLength(z0.data(), z0.size()), z1.data());
+    subtractMagnitude(z1.data(), z1Length, z2.data(), trimmedLength(z2.data(), z2.size()), z1.data());
+    z1Length = trimmedLength(z1.data(), z1Length);
+
+    memcpy(out, z0.data(), z0.size() * sizeof(uint64_t));
+    memcpy(out + 2 * half, z2.data(), z2.size() * sizeof(uint64_t));
+    addShifted(out, n + m, z1.data(), z1Length, half);
+}
+
+// out = a * b, out has n + m zeroed limbs
+static void multiplyMagnitude(const uint64_t *a, size_t n, const uint64_t *b, size_t m, uint64_t *out){
+    if (n < m){
+        std::swap(a, b);
+        std::swap(n, m);
+    }
+    if (m == 0){
+        return;
+    }
+    if (m < KaratsubaThreshold){
+        multiplySchoolbook(a, n, b, m, out);
+        return;
+    }
+    if (2 * m <= n){
+        // Unbalanced: multiply b by m-limb slices of a
+        Limbs partial(2 * m);
+        for (size_t offset = 0; offset < n; offset += m){
+            size_t sliceLength = std::min(m, n - offset);
+            std::fill(partial.begin(), partial.end(), 0);
+            multiplyMagnitude(a + offset, sliceLength, b, m, partial.data());
+            addShifted(out, n + m, partial.data(), trimmedLength(partial.data(), sliceLength + m), offset);
+        }
+        return;
+    }
+    multiplyKaratsuba(a, n, b, m, out);
+}
+
+// Knuth's algorithm D on 64-bit limbs. quotient gets n - m + 1 limbs,
+// remainder m limbs; b must have a non-zero top limb.
+static void divideMagnitude(const uint64_t *a, size_t n, const uint64_t *b, size_t m, Limbs &quotient, Limbs &remainder){
+    if (compareMagnitude(a, n, b, m) < 0){
+        quotient.clear();
+        remainder.assign(a, a + n);
+        return;
+    }
+    quotient.assign(n - m + 1, 0);
+
+    if (m == 1){
+        unsigned __int128 rest = 0;
+        for (size_t i = n; i-- > 0;){
+            rest = (rest << 64) | a[i];
+            quotient[i] = static_cast<uint64_t>(rest / b[0]);
+            rest %= b[0];
+        }
+        remainder.assign(1, static_cast<uint64_t>(rest));
+        return;
+    }
+
+    // Normalize so the divisor's top bit is set, which keeps qhat within 2 of the true digit
+    int shift = __builtin_clzll(b[m - 1]);
+    Limbs divisor(m), dividend(n + 1);
+    for (size_t i = m; i-- > 0;){
+        divisor[i] = (b[i] << shift) | (shift && i > 0 ? b[i - 1] >> (64 - shift) : 0);
+    }
+    dividend[n] = shift ? a[n - 1] >> (64 - shift) : 0;
+    for (size_t i = n; i-- > 0;){
+        dividend[i] = (a[i] << shift) | (shift && i > 0 ? a[i - 1] >> (64 - shift) : 0);
+    }
+
+    const unsigned __int128 base = static_cast<unsigned __int128>(1) << 64;
+    for (size_t j = n - m + 1; j-- > 0;){
+        unsigned __int128 top = (static_cast<unsigned __int128>(dividend[j + m]) << 64) | dividend[j + m - 1];
+        unsigned __int128 qhat = top / divisor[m - 1];
+        unsigned __int128 rhat = top % divisor[m - 1];
+        while (qhat >= base ||
+               qhat * divisor[m - 2] > ((rhat << 64) | dividend[j + m - 2])){
+            qhat--;
+            rhat += divisor[m - 1];
+            if (rhat >= base){
+                break;
+            }
+        }
+
+        // dividend[j...j+m] -= qhat * divisor
+        unsigned __int128 carry = 0;
+        __int128 borrow = 0;
+        for (size_t i = 0; i < m; i++){
+            unsigned __int128 product = qhat * divisor[i] + carry;
+            carry = product >> 64;
+            __int128 difference = static_cast<__int128>(dividend[i + j]) - static_cast<uint64_t>(product) + borrow;
+            dividend[i + j] = static_cast<uint64_t>(difference);
+            borrow = difference >> 64;
+        }
+        __int128 difference = static_cast<__int128>(dividend[j + m]) - static_cast<__int128>(carry) + borrow;
+        dividend[j + m] = static_cast<uint64_t>(difference);
+
+        quotient[j] = static_cast<uint64_t>(qhat);
+        if (difference < 0){
+            // qhat was one too large, add the divisor back
+            quotient[j]--;
+            unsigned __int128 sum = 0;
+            for (size_t i = 0; i < m; i++){
+                sum += static_cast<unsigned __int128>(dividend[i + j]) + divisor[i];
+                dividend[i + j] = static_cast<uint64_t>(sum);
+                sum >>= 64;
+            }
+            dividend[j + m] += static_cast<uint64_t>(sum);
+        }
+    }
+
+    remainder.resize(m);
+    for (size_t i = 0; i < m; i++){
+        remainder[i] = (dividend[i] >> shift) | (shift ? dividend[i + 1] << (64 - shift) : 0);
+    }
+}
+
+static BigNum *allocateNumber(size_t capacity){
+    GCBackend *backend = GCBackend::current();
+    if (!backend){
+        std::cerr << "bignum used outside of a running program\n";
+        runtimeError();
+    }
+    BigNum *number = static_cast<BigNum *>(
+        backend->allocate(HeapKind::Bignum, sizeof(BigNum) + capacity * sizeof(uint64_t)));
+    number->capacity = static_cast<uint32_t>(capacity);
+    return number;
+}
+
+// Turns a sign and magnitude into a value. With a slot, the number already in
+// the slot is overwritten when the slot owns it and it is large enough; new
+// numbers for a slot get headroom so a growing accumulator rarely reallocates.
+static int64_t makeNumber(bool negative, const uint64_t *limbs, size_t length, int64_t *slot){
+    length = trimmedLength(limbs, length);
+    if (length == 0){
+        return tagSmall(0);
+    }
+    if (length == 1){
+        if (!negative && limbs[0] < SmallLimit){
+            return tagSmall(static_cast<int64_t>(limbs[0]));
+        }
+        if (negative && limbs[0] <= SmallLimit){
+            return tagSmall(static_cast<int64_t>(0 - limbs[0]));
+        }
+    }
+
+    BigNum *number = nullptr;
+    if (slot && !isSmall(*slot)){
+        BigNum *current = heapNumber(*slot);
+        if (current->owner == slot && current->capacity >= length){
+            number = current;
+        }
+    }
+    if (!number){
+        number = allocateNumber(slot ? length + length / 2 + 1 : length);
+        number->owner = slot;
+    }
+    memmove(number->limbs(), limbs, length * sizeof(uint64_t));
+    number->length = static_cast<uint32_t>(length);
+    number->negative = negative;
+    return reinterpret_cast<int64_t>(number);
+}
+
+static thread_local Limbs scratch;
+
+static int64_t addSigned(int64_t lhs, int64_t rhs, bool subtract, int64_t *slot){
+    Operand a(lhs), b(rhs);
+    bool bNegative = subtract ? !b.negative : b.negative;
+    scratch.assign(std::max(a.length, b.length) + 1, 0);
+    if (a.negative == bNegative){
+        size_t length = addMagnitude(a.limbs, a.length, b.limbs, b.length, scratch.data());
+        return makeNumber(a.negative, scratch.data(), length, slot);
+    }
+    if (compareMagnitude(a.limbs, a.length, b.limbs, b.length) >= 0){
+        subtractMagnitude(a.limbs, a.length, b.limbs, b.length, scratch.data());
+        return makeNumber(a.negative, scratch.data(), a.length, slot);
+    }
+    subtractMagnitude(b.limbs, b.length, a.limbs, a.length, scratch.data());
+    return makeNumber(bNegative, scratch.data(), b.length, slot);
+}
+
+static int64_t multiplySigned(int64_t lhs, int64_t rhs, int64_t *slot){
+    Operand a(lhs), b(rhs);
+    scratch.assign(a.length + b.length, 0);
+    multiplyMagnitude(a.limbs, a.length, b.limbs, b.length, scratch.data());
+    return makeNumber(a.negative != b.negative, scratch.data(), scratch.size(), slot);
+}
+
+static int64_t divideSigned(int64_t lhs, int64_t rhs, bool wantRemainder){
+    if (isSmall(lhs) && isSmall(rhs) && smallValue(rhs) != 0){
+        // Both fit in 63 bits, so only -2^62 / -1 leaves the inline range
+        int64_t result = wantRemainder ? smallValue(lhs) % smallValue(rhs) : smallValue(lhs) / smallValue(rhs);
+        if (result != static_cast<int64_t>(SmallLimit)){
+            return tagSmall(result);
+        }
+    }
+    Operand a(lhs), b(rhs);
+    if (b.length == 0){
+        std::cerr << "bignum division by zero\n";
+        runtimeError();
+    }
+    Limbs quotient, remainder;
+    divideMagnitude(a.limbs, a.length, b.limbs, b.length, quotient, remainder);
+    if (wantRemainder){
+        return makeNumber(a.negative, remainder.data(), remainder.size(), nullptr);
+    }
+    return makeNumber(a.negative != b.negative, quotient.data(), quotient.size(), nullptr);
+}
+
+extern "C" int64_t dnm_big_from_i128(uint64_t low, int64_t high){
+    bool negative = high < 0;
+    unsigned __int128 value = (static_cast<unsigned __int128>(static_cast<uint64_t>(high)) << 64) | low;
+    if (negative){
+        value = 0 - value;
+    }
+    uint64_t limbs[2] = {static_cast<uint64_t>(value), static_cast<uint64_t>(value >> 64)};
+    return makeNumber(negative, limbs, 2, nullptr);
+}
+
+extern "C" int64_t dnm_big_add(int64_t lhs, int64_t rhs){
+    return addSigned(lhs, rhs, false, nullptr);
+}
+
+extern "C" int64_t dnm_big_sub(int64_t lhs, int64_t rhs){
+    return addSigned(lhs, rhs, true, nullptr);
+}
+
+extern "C" int64_t dnm_big_mul(int64_t lhs, int64_t rhs){
+    return multiplySigned(lhs, rhs, nullptr);
+}
+
+extern "C" int64_t dnm_big_div(int64_t lhs, int64_t rhs){
+    return divideSigned(lhs, rhs, false);
+}
+
+extern "C" int64_t dnm_big_rem(int64_t lhs, int64_t rhs){
+    return divideSigned(lhs, rhs, true);
+}
+
+extern "C" int32_t dnm_big_compare(int64_t lhs, int64_t rhs){
+    if (isSmall(lhs) && isSmall(rhs)){
+        return (lhs > rhs) - (lhs < rhs);
+    }
+    Operand a(lhs), b(rhs);
+    if (a.negative != b.negative){
+        return a.negative ? -1 : 1;
+    }
+    int magnitude = compareMagnitude(a.limbs, a.length, b.limbs, b.length);
+    return a.negative ? -magnitude : magnitude;
+}
+
+extern "C" void dnm_big_add_assign(int64_t *slot, int64_t lhs, int64_t rhs){
+    *slot = addSigned(lhs, rhs, false, slot);
+}
+
+extern "C" void dnm_big_sub_assign(int64_t *slot, int64_t lhs, int64_t rhs){
+    *slot = addSigned(lhs, rhs, true, slot);
+}
+
+extern "C" void dnm_big_mul_assign(int64_t *slot, int64_t lhs, int64_t rhs){
+    *slot = multiplySigned(lhs, rhs, slot);
+}
+
+extern "C" void dnm_big_share(int64_t value){
+    if (!isSmall(value)){
+        heapNumber(value)->owner = SharedOwner;
+    }
+}
+
+extern "C" void dnm_print_big(int64_t value){
+    Operand number(value);
+    Limbs rest(number.limbs, number.limbs + number.length);
+    std::vector<uint64_t> chunks;
+    const uint64_t chunkBase = 10000000000000000000ULL;
+    size_t length = rest.size();
+    // Peel off base 10^19 chunks, least significant first
+    while (length > 0){
+        unsigned __int128 carry = 0;
+        for (size_t i = length; i-- > 0;){
+            carry = (carry << 64) | rest[i];
+            rest[i] = static_cast<uint64_t>(carry / chunkBase);
+            carry %= chunkBase;
+        }
+        chunks.push_back(static_cast<uint64_t>(carry));
+        length = trimmedLength(rest.data(), length);
+    }
+
+    std::string text = number.negative ? "-" : "";
+    text += std::to_string(chunks.empty() ? 0 : chunks.back());
+    for (size_t i = chunks.size() > 0 ? chunks.size() - 1 : 0; i-- > 0;){
+        std::string digits = std::to_string(chunks[i]);
+        text.append(19 - digits.size(), '0');
+        text += digits;
+    }
+    text += '\n';
+    appendOutput(text.data(), text.size());
+}
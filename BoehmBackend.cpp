@@ -0,0 +1,74 @@
+#ifdef DNM_WITH_BOEHM_GC
+
+#define GC_THREADS
+#include <gc/gc.h>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "include/BoehmBackend.h"
+#include "include/Log.h"
+#include "include/Runtime.h"
+
+void BoehmBackend::initialize(){
+    // Variables hold array data pointers, which point past the array's header
+    GC_set_all_interior_pointers(1);
+    GC_INIT();
+    // Server and batch workers are started with std::thread
+    GC_allow_register_threads();
+}
+
+BoehmBackend::BoehmBackend() : collectionsAtStart(GC_get_gc_no()){
+    if (!GC_thread_is_registered()){
+        GC_stack_base stackBase;
+        GC_get_stack_base(&stackBase);
+        GC_register_my_thread(&stackBase);
+        registeredThread = true;
+    }
+}
+
+BoehmBackend::~BoehmBackend(){
+    DNM_LOG(GC, INFO) << "Boehm GC: " << getCollections() << " collections, heap " << getHeapBytes() << " bytes";
+    for (void* slot : globalRoots){
+        GC_remove_roots(slot, static_cast<char*>(slot) + sizeof(uint64_t));
+    }
+    if (registeredThread){
+        GC_unregister_my_thread();
+    }
+}
+
+void* BoehmBackend::allocate(HeapKind kind, size_t size){
+    size_t total = sizeof(HeapHeader) + size;
+    if (total < size){
+        std::cerr << "Out of memory allocating " << size << " bytes\n";
+        abort();
+    }
+    // No heap kind holds references, so Boehm never has to scan the objects
+    HeapHeader* header = static_cast<HeapHeader*>(GC_MALLOC_ATOMIC(total));
+    if (!header){
+        std::cerr << "Out of memory allocating " << size << " bytes\n";
+        runtimeError();
+    }
+    memset(header, 0, total);
+    header->kind = static_cast<uint32_t>(kind);
+    header->size = size;
+    return header->payload();
+}
+
+void BoehmBackend::collectGarbage(){
+    GC_gcollect();
+}
+
+void BoehmBackend::addGlobalRoot(void* slot, HeapKind){
+    GC_add_roots(slot, static_cast<char*>(slot) + sizeof(uint64_t));
+    globalRoots.push_back(slot);
+}
+
+size_t BoehmBackend::getHeapBytes() const{
+    return GC_get_heap_size() - GC_get_free_bytes();
+}
+
+size_t BoehmBackend::getCollections() const{
+    return GC_get_gc_no() - collectionsAtStart;
+}
+
+#endif
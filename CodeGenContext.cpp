@@ -1,31 +1,46 @@
 #include <iostream>
 #include "include/CodeGenContext.h"
+#include "include/Log.h"
+#include "include/Strings.h"
+#include "include/VisitorRangeAnalysis.h"
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/ExecutionEngine/Orc/Core.h>
+#include <llvm/IR/MDBuilder.h>
+#include <algorithm>
+
+bool CodeGenContext::defaultBoundsCheck = false;
+
+bool CodeGenContext::generateCode(std::vector<std::unique_ptr<ASTNode>> nodeList) {
+    if (!module) {
+        module = std::make_unique<llvm::Module>(mainFunctionName, llvmContext);
+    }
+    // Codegen sizes runtime objects, e.g. array elements, with the JIT's layout
+    module->setDataLayout(JIT->getDataLayout());
 
-void CodeGenContext::generateCode(std::vector<std::unique_ptr<ASTNode>> nodeList) {
     llvm::FunctionType *funcType = llvm::FunctionType::get(
         llvm::Type::getVoidTy(llvmContext), {}, false);
-    mainFunction = std::unique_ptr<llvm::Function>(llvm::Function::Create(
-        funcType, llvm::Function::ExternalLinkage, "main", module.get()));
-    llvm::Function* fn = llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, "main", module.get());
+    mainFunction = llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, mainFunctionName, module.get());
 
-    llvm::BasicBlock *entry = llvm::BasicBlock::Create(llvmContext, "entry", fn);
+    llvm::BasicBlock *entry = llvm::BasicBlock::Create(llvmContext, "entry", mainFunction);
     builder.SetInsertPoint(entry);
     pushBlock(entry);
+    if (boundsCheck) {
+        VisitorRangeAnalysis(globalTopLevel).run(nodeList);
+    }
+    VisitorEscapeAnalysis(returnedArguments).run(nodeList);
     int i = 0;
     for (const auto &node : nodeList) {
-        gcManager.addObject(node.get());
         llvm::BasicBlock* prevInsertPoint = nullptr;
         if (dynamic_cast<FunctionNode*>(node.get())) {
             prevInsertPoint = builder.GetInsertBlock();
         }
 
         if (!node->codeGeneration(*this)) {
-            std::cout << "Code generation failed for AST node No." << i << ": " << node->toString() << "\n";
+            failedNodes++;
+            DNM_LOG(CODEGEN, DEBUG) << "Code generation failed for AST node No." << i << ": " << node->toString();
         } else {
-            std::cout << "Succeed for AST Node: " << node->toString() << "\n";
+            DNM_LOG(CODEGEN, TRACE) << "Succeed for AST Node: " << node->toString();
         }
 
         if (dynamic_cast<FunctionNode*>(node.get())) {
@@ -37,45 +52,312 @@ void CodeGenContext::generateCode(std::vector<std::unique_ptr<ASTNode>> nodeList
 
     popBlock();
     builder.CreateRetVoid();
+    createRootFrame(mainFunction);
+    finishFunction(mainFunction);
+    // Left behind by functions that failed to compile
+    rootSlots.clear();
+    arrayAllocations.clear();
+    stringLiterals.clear();
+
+    if (Log::isDumpEnabled(Log::IR) || Log::isEnabled(Log::CODEGEN, Log::TRACE)) {
+        std::string IR;
+        llvm::raw_string_ostream OS(IR);
+        module->print(OS, nullptr);
+        OS.flush();
+        if (Log::isDumpEnabled(Log::IR)) {
+            Log::writeDump(Log::IR, IR);
+        }
+        DNM_LOG(CODEGEN, TRACE) << "Module IR:\n" << IR;
+    }
+
+    // A broken REPL input must not take the whole session down with it
+    if (globalTopLevel && llvm::verifyModule(*module, &llvm::errs())) {
+        for (auto &global : module->globals()) {
+            if (!global.isDeclaration()) {
+                globals.erase(global.getName().str());
+            }
+        }
+        for (auto &function : module->functions()) {
+            if (!function.isDeclaration()) {
+                functions.erase(function.getName().str());
+            }
+        }
+        module.reset();
+        return false;
+    }
 
-    module->print(llvm::outs(), nullptr);
     auto TSM = llvm::orc::ThreadSafeModule(std::move(module), std::make_unique<llvm::LLVMContext>());
 
-    if (auto Err = JIT->addModule(std::move(TSM))) {
+    auto moduleTracker = dylib->createResourceTracker();
+    if (auto Err = JIT->addModule(std::move(TSM), moduleTracker)) {
         llvm::errs() << "Failed to add module to JIT: " << llvm::toString(std::move(Err)) << "\n";
-        return;
+        return false;
     } else {
-      	llvm::errs() << "Successfully loaded JIT\n";
-      	return;
+      	DNM_LOG(JIT, DEBUG) << "Successfully loaded JIT";
+        moduleTrackers.push_back(std::move(moduleTracker));
+      	return true;
+    }
+}
+
+std::pair<llvm::Value*, llvm::Type*> CodeGenContext::lookupVariable(const std::string& name) {
+    for (auto blockIt = blocks.rbegin(); blockIt != blocks.rend(); ++blockIt) {
+        auto &locals = (*blockIt)->locals;
+        auto it = locals.find(name);
+        if (it != locals.end()) {
+            return it->second;
+        }
+    }
+
+    auto global = globals.find(name);
+    if (global == globals.end() || blocks.empty()) {
+        return {nullptr, nullptr};
     }
+    // Defined by an earlier module, declare it in this one
+    // Array variables hold a pointer to the array's data
+    llvm::Type *storedType = global->second->isArrayTy() ? llvm::PointerType::get(builder.getInt8Ty(), 0) : global->second;
+    llvm::Constant *declaration = module->getOrInsertGlobal(name, storedType);
+    blocks.front()->locals[name] = {declaration, global->second};
+    return {declaration, global->second};
 }
 
-void CodeGenContext::runCode() {
-    std::cout << "Running code...\n";
+llvm::Function* CodeGenContext::lookupFunction(const std::string& name) {
+    if (llvm::Function *function = module->getFunction(name)) {
+        return function;
+    }
+
+    auto it = functions.find(name);
+    if (it == functions.end()) {
+        return nullptr;
+    }
+    return llvm::Function::Create(it->second, llvm::Function::ExternalLinkage, name, module.get());
+}
+
+void CodeGenContext::declareGlobal(const std::string& name, llvm::Type* type) {
+    globals[name] = type;
+}
+
+void CodeGenContext::declareFunction(const std::string& name, llvm::FunctionType* type, std::vector<llvm::Type*> arrayTypes) {
+    functions[name] = type;
+    functionArrays[name] = std::move(arrayTypes);
+}
+
+llvm::Type* CodeGenContext::functionArrayType(const std::string& name, size_t index) {
+    auto it = functionArrays.find(name);
+    if (it == functionArrays.end() || index >= it->second.size()) {
+        return nullptr;
+    }
+    return it->second[index];
+}
+
+llvm::AllocaInst* CodeGenContext::createRootSlot(llvm::Type* type, const std::string& name) {
+    llvm::Function *function = builder.GetInsertBlock()->getParent();
+    llvm::IRBuilder<> entryBuilder(&function->getEntryBlock(), function->getEntryBlock().begin());
+    llvm::AllocaInst *slot = entryBuilder.CreateAlloca(type, nullptr, name);
+    rootSlots[function].push_back(slot);
+    return slot;
+}
+
+llvm::AllocaInst* CodeGenContext::rootValue(llvm::Value* value) {
+    llvm::AllocaInst *slot = createRootSlot(value->getType(), "gcTemporary");
+    builder.CreateStore(value, slot);
+    return slot;
+}
+
+void CodeGenContext::registerGlobalRoot(llvm::GlobalVariable* global, HeapKind kind) {
+    llvm::FunctionCallee addGlobal = module->getOrInsertFunction(
+        "dnm_gc_add_global", builder.getVoidTy(), global->getType(), builder.getInt32Ty());
+    builder.CreateCall(addGlobal, {global, builder.getInt32(static_cast<uint32_t>(kind))});
+}
+
+llvm::Constant* CodeGenContext::internString(const std::string& text) {
+    llvm::Type *pointerType = llvm::PointerType::get(builder.getInt8Ty(), 0);
+    if (text.size() <= StringInfo::MaxInlineLength) {
+        return llvm::ConstantExpr::getIntToPtr(builder.getInt64(StringInfo::inlineWord(text.data(), text.size())), pointerType);
+    }
+    llvm::Constant *&literal = stringLiterals[text];
+    if (literal) {
+        return literal;
+    }
+    // A StringInfo without an owner, followed by the characters
+    llvm::Constant *chars = llvm::ConstantDataArray::getString(llvmContext, text, false);
+    llvm::StructType *literalType = llvm::StructType::get(llvmContext, {pointerType, builder.getInt64Ty(), chars->getType()});
+    llvm::Constant *init = llvm::ConstantStruct::get(literalType, {
+        llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(pointerType)), builder.getInt64(text.size()), chars});
+    auto global = new llvm::GlobalVariable(*module, literalType, true, llvm::GlobalValue::PrivateLinkage, init, ".str");
+    // Even, like every pointer to a string's characters
+    global->setAlignment(llvm::Align(16));
+    literal = llvm::ConstantExpr::getInBoundsGetElementPtr(
+        literalType, global, llvm::ArrayRef<llvm::Constant*>{builder.getInt32(0), builder.getInt32(2), builder.getInt32(0)});
+    return literal;
+}
+
+void CodeGenContext::createSafepoint() {
+    llvm::Function *function = builder.GetInsertBlock()->getParent();
+    llvm::Type *int32Type = builder.getInt32Ty();
+    llvm::LoadInst *requested = builder.CreateLoad(int32Type, module->getOrInsertGlobal("dnm_gc_requested", int32Type), "gcRequested");
+    requested->setAtomic(llvm::AtomicOrdering::Monotonic);
+    requested->setAlignment(llvm::Align(4));
+
+    llvm::BasicBlock *collectBlock = llvm::BasicBlock::Create(llvmContext, "gcSafepoint", function);
+    llvm::BasicBlock *doneBlock = llvm::BasicBlock::Create(llvmContext, "gcSafepointDone", function);
+    builder.CreateCondBr(builder.CreateICmpNE(requested, builder.getInt32(0)), collectBlock, doneBlock,
+                         llvm::MDBuilder(llvmContext).createBranchWeights(1, 1000));
+    builder.SetInsertPoint(collectBlock);
+    builder.CreateCall(module->getOrInsertFunction("dnm_gc_safepoint", builder.getVoidTy()));
+    builder.CreateBr(doneBlock);
+    builder.SetInsertPoint(doneBlock);
+}
+
+void CodeGenContext::countArrayAllocation(const ArrayDeclaration* declaration, bool onStack) {
+    arrayAllocations[builder.GetInsertBlock()->getParent()][declaration] = onStack;
+}
+
+void CodeGenContext::finishFunction(llvm::Function* function) {
+    auto declarations = arrayAllocations.find(function);
+    if (declarations == arrayAllocations.end()) {
+        return;
+    }
+    size_t onStack = std::count_if(declarations->second.begin(), declarations->second.end(),
+                                   [](const std::pair<const ArrayDeclaration* const, bool>& declaration) { return declaration.second; });
+    DNM_LOG(CODEGEN, INFO) << function->getName().str() << ": " << onStack << " of "
+                           << declarations->second.size() << " arrays kept off the heap";
+    arrayAllocations.erase(declarations);
+}
+
+void CodeGenContext::createRootFrame(llvm::Function* function, llvm::Instruction* prologueEnd) {
+    auto found = rootSlots.find(function);
+    if (found == rootSlots.end()) {
+        return;
+    }
+    std::vector<llvm::AllocaInst*> slots = std::move(found->second);
+    rootSlots.erase(found);
+    // The frame lists bignum words before array pointers
+    auto arraysBegin = std::stable_partition(slots.begin(), slots.end(), [](llvm::AllocaInst *slot) {
+        return slot->getAllocatedType()->isIntegerTy(64);
+    });
+    uint32_t bignumSlots = arraysBegin - slots.begin();
+
+    // Gather the static allocas at the top of the entry block and set the
+    // frame up after them, in front of the function's own code
+    llvm::BasicBlock &entry = function->getEntryBlock();
+    llvm::Instruction *firstCode = nullptr;
+    for (auto it = entry.begin(); it != entry.end();) {
+        llvm::Instruction &instruction = *it++;
+        if (!llvm::isa<llvm::AllocaInst>(instruction)) {
+            if (!firstCode) {
+                firstCode = &instruction;
+            }
+        } else if (firstCode) {
+            instruction.moveBefore(firstCode);
+        }
+    }
+    builder.SetInsertPoint(firstCode);
+
+    llvm::Type *pointerType = llvm::PointerType::get(builder.getInt8Ty(), 0);
+    llvm::ArrayType *slotsType = llvm::ArrayType::get(builder.getInt64Ty(), slots.size());
+    llvm::StructType *frameType = llvm::StructType::get(
+        llvmContext, {pointerType, builder.getInt32Ty(), builder.getInt32Ty(), slotsType});
+    llvm::AllocaInst *frame = llvm::IRBuilder<>(firstCode).CreateAlloca(frameType, nullptr, "gcFrame");
+    builder.CreateStore(builder.getInt32(bignumSlots), builder.CreateStructGEP(frameType, frame, 1));
+    builder.CreateStore(builder.getInt32(slots.size() - bignumSlots), builder.CreateStructGEP(frameType, frame, 2));
+    llvm::Value *slotArray = builder.CreateStructGEP(frameType, frame, 3);
+    // Nothing is stored in the slots yet when the first collection may look at them
+    builder.CreateMemSet(slotArray, builder.getInt8(0), slots.size() * sizeof(uint64_t), llvm::Align(8));
+    for (size_t i = 0; i < slots.size(); i++) {
+        llvm::Value *frameSlot = builder.CreateConstInBoundsGEP2_32(slotsType, slotArray, 0, i);
+        frameSlot->takeName(slots[i]);
+        slots[i]->replaceAllUsesWith(frameSlot);
+        slots[i]->eraseFromParent();
+    }
+    builder.CreateCall(module->getOrInsertFunction("dnm_gc_enter", builder.getVoidTy(), frame->getType()), {frame});
+
+    // The entry safepoint follows the parameters' stores into their slots;
+    // until then the arguments are only in registers
+    llvm::Instruction *bodyStart = prologueEnd ? prologueEnd->getNextNode() : firstCode;
+    llvm::BasicBlock *body = entry.splitBasicBlock(bodyStart, "entryBody");
+    entry.getTerminator()->eraseFromParent();
+    builder.SetInsertPoint(&entry);
+    createSafepoint();
+    builder.CreateBr(body);
+
+    std::vector<llvm::ReturnInst*> returns;
+    for (auto &block : *function) {
+        if (auto ret = llvm::dyn_cast<llvm::ReturnInst>(block.getTerminator())) {
+            returns.push_back(ret);
+        }
+    }
+    llvm::FunctionCallee leave = module->getOrInsertFunction("dnm_gc_leave", builder.getVoidTy(), frame->getType());
+    for (llvm::ReturnInst *ret : returns) {
+        builder.SetInsertPoint(ret);
+        builder.CreateCall(leave, {frame});
+    }
+}
+
+bool CodeGenContext::runCode() {
+    DNM_LOG(JIT, DEBUG) << "Running code...";
 
     if (!JIT) {
         std::cerr << "JIT is not initialized.\n";
-        return;
+        return false;
     }
 
-    std::cout << "Available symbols in JIT:\n";
-    auto& ES = *JIT->getExecutionSession();
-    ES.dump(llvm::outs());
+    if (Log::isEnabled(Log::JIT, Log::TRACE)) {
+        std::string symbols;
+        llvm::raw_string_ostream OS(symbols);
+        JIT->getExecutionSession()->dump(OS);
+        OS.flush();
+        DNM_LOG(JIT, TRACE) << "Available symbols in JIT:\n" << symbols;
+    }
 
-    auto Sym = JIT->lookup("main.1");
+    auto Sym = JIT->lookup(*dylib, mainFunctionName);
     if (!Sym) {
         llvm::errs() << "Failed to find 'main' function: " << llvm::toString(Sym.takeError()) << "\n";
-        return;
+        return false;
     }
 
     using MainFuncType = void (*)();
     auto MainFunc = Sym->getAddress().toPtr<MainFuncType>();
 
     if (MainFunc) {
-        std::cout << "Calling JIT-compiled 'main' function...\n";
-        MainFunc();
-        std::cout << "Code executed.\n";
-    } else {
-        std::cerr << "Failed to cast 'main' function pointer.\n";
+        DNM_LOG(JIT, DEBUG) << "Calling JIT-compiled '" << mainFunctionName << "' function...";
+        GCBackend *previousHeap = GCBackend::current();
+        GCBackend::setCurrent(gcBackend.get());
+        std::jmp_buf errorJump;
+        std::jmp_buf *previousJump = setRuntimeErrorJump(&errorJump);
+        bool failed = false;
+        if (setjmp(errorJump) == 0) {
+            MainFunc();
+        } else {
+            // The entry function's frame is the first on the shadow stack
+            gcBackend->abandonFrames();
+            failed = true;
+        }
+        setRuntimeErrorJump(previousJump);
+        GCBackend::setCurrent(previousHeap);
+        flushOutput();
+        if (failed) {
+            DNM_LOG(JIT, DEBUG) << "Code stopped by a runtime error.";
+            return false;
+        }
+        DNM_LOG(JIT, DEBUG) << "Code executed.";
+
+        if (Log::isEnabled(Log::JIT, Log::INFO)) {
+            auto Stats = JIT->getMemoryStats();
+            DNM_LOG(JIT, INFO) << "JIT memory: " << Stats.bytesReserved << " bytes reserved, "
+                               << Stats.bytesUsed << " used, " << Stats.bytesFragmented << " fragmented";
+        }
+        return true;
+    }
+
+    std::cerr << "Failed to cast 'main' function pointer.\n";
+    return false;
+}
+
+void CodeGenContext::releaseCode() {
+    for (auto &moduleTracker : moduleTrackers) {
+        if (auto Err = JIT->removeModule(std::move(moduleTracker))) {
+            llvm::errs() << "Failed to release JIT code: " << llvm::toString(std::move(Err)) << "\n";
+        }
     }
+    moduleTrackers.clear();
 }
\ No newline at end of file
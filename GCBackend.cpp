@@ -0,0 +1,65 @@
+#include "include/BoehmBackend.h"
+#include "include/GCBackend.h"
+#include "include/GCManager.h"
+
+std::atomic<int32_t> dnm_gc_requested{0};
+
+GCBackend::Kind GCBackend::defaultKind = GCBackend::PRECISE;
+
+static thread_local GCBackend* currentBackend = nullptr;
+
+GCBackend* GCBackend::current(){
+    return currentBackend;
+}
+
+void GCBackend::setCurrent(GCBackend* backend){
+    currentBackend = backend;
+}
+
+bool GCBackend::isAvailable(Kind kind){
+    if (kind == BOEHM) {
+#ifdef DNM_WITH_BOEHM_GC
+        return true;
+#else
+        return false;
+#endif
+    }
+    return true;
+}
+
+void GCBackend::initialize(Kind kind){
+    if (kind == BOEHM) {
+#ifdef DNM_WITH_BOEHM_GC
+        BoehmBackend::initialize();
+#endif
+    }
+}
+
+// Falls back to GCManager where Boehm is not built in; main checks isAvailable first
+std::unique_ptr<GCBackend> GCBackend::create(Kind kind){
+    if (kind == BOEHM) {
+#ifdef DNM_WITH_BOEHM_GC
+        return std::make_unique<BoehmBackend>();
+#endif
+    }
+    return std::make_unique<GCManager>();
+}
+
+void dnm_gc_enter(ShadowFrame *frame){
+    GCBackend::current()->enterFrame(frame);
+}
+
+void dnm_gc_leave(ShadowFrame *frame){
+    GCBackend::current()->leaveFrame(frame);
+}
+
+void dnm_gc_add_global(void *slot, uint32_t kind){
+    GCBackend::current()->addGlobalRoot(slot, static_cast<HeapKind>(kind));
+}
+
+void dnm_gc_safepoint(){
+    // Another thread's heap may be the one waiting
+    if (GCBackend *backend = GCBackend::current()) {
+        backend->safepoint();
+    }
+}
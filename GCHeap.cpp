@@ -0,0 +1,348 @@
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "include/GCHeap.h"
+#include "include/GCWorkers.h"
+#include "include/Runtime.h"
+
+static size_t alignUp(size_t size, size_t alignment){
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+char *GCHeap::Block::cells(){
+    return reinterpret_cast<char *>(this) + CellsOffset;
+}
+
+static void outOfMemory(size_t size){
+    std::cerr << "Out of memory allocating " << size << " bytes\n";
+    runtimeError();
+}
+
+GCHeap::GCHeap(){
+    static_assert(sizeof(HeapHeader) % CellAlignment == 0, "payloads must stay 16-byte aligned");
+    // 16-byte steps up to 128 bytes, then four classes per doubling, so no
+    // cell wastes more than a fifth of itself
+    for (uint32_t size = CellAlignment; size <= MaxCellSize;){
+        sizeClasses.emplace_back();
+        sizeClasses.back().cellSize = size;
+        uint32_t powerOfTwo = 1u << (31 - __builtin_clz(size));
+        size += size < 128 ? CellAlignment : powerOfTwo / 4;
+    }
+    classOfSize.resize(MaxCellSize / CellAlignment + 1);
+    uint8_t classIndex = 0;
+    for (size_t steps = 1; steps < classOfSize.size(); steps++){
+        while (sizeClasses[classIndex].cellSize < steps * CellAlignment){
+            classIndex++;
+        }
+        classOfSize[steps] = classIndex;
+    }
+}
+
+GCHeap::~GCHeap(){
+    finishSweep(true);
+    for (auto &sizeClass : sizeClasses){
+        for (Block *block : sizeClass.blocks){
+            free(block);
+        }
+    }
+    for (HeapHeader *header : largeObjects){
+        free(header);
+    }
+}
+
+bool GCHeap::isLarge(const HeapHeader *header){
+    return header->size > MaxCellSize - sizeof(HeapHeader);
+}
+
+GCHeap::Block *GCHeap::newBlock(uint32_t classIndex){
+    Block *block = static_cast<Block *>(aligned_alloc(BlockSize, BlockSize));
+    if (!block){
+        outOfMemory(BlockSize);
+    }
+    memset(block, 0, sizeof(Block));
+    block->sizeClass = classIndex;
+    block->cellSize = sizeClasses[classIndex].cellSize;
+    block->cellCount = (BlockSize - CellsOffset) / block->cellSize;
+    sizeClasses[classIndex].blocks.push_back(block);
+    {
+        std::lock_guard<std::mutex> lock(allBlocksMutex);
+        allBlocks.insert(block);
+    }
+    stats.blocks++;
+    stats.bytesReserved += BlockSize;
+    return block;
+}
+
+void *GCHeap::allocateSmall(SizeClass &sizeClass, uint32_t classIndex){
+    while (sizeClass.allocationCursor < sizeClass.blocks.size()){
+        Block *block = sizeClass.blocks[sizeClass.allocationCursor];
+        char *cell = nullptr;
+        if (block->freeList){
+            cell = reinterpret_cast<char *>(block->freeList);
+            block->freeList = block->freeList->next;
+        } else if (block->bumpIndex < block->cellCount){
+            cell = block->cells() + size_t(block->bumpIndex++) * block->cellSize;
+        }
+        if (cell){
+            size_t index = block->cellIndex(cell);
+            block->liveBits[index / 64] |= uint64_t(1) << (index % 64);
+            block->liveCells++;
+            return cell;
+        }
+        sizeClass.allocationCursor++;
+    }
+    newBlock(classIndex);
+    return allocateSmall(sizeClass, classIndex);
+}
+
+void *GCHeap::allocate(HeapKind kind, size_t size){
+    if (size > SIZE_MAX - MaxCellSize){
+        outOfMemory(size);
+    }
+    size_t total = alignUp(sizeof(HeapHeader) + size, CellAlignment);
+    HeapHeader *header;
+    if (total <= MaxCellSize){
+        uint32_t classIndex = classOfSize[total / CellAlignment];
+        SizeClass &sizeClass = sizeClasses[classIndex];
+        header = static_cast<HeapHeader *>(allocateSmall(sizeClass, classIndex));
+        // Freed cells still hold their old contents
+        memset(header, 0, total);
+        stats.bytesInUse += sizeClass.cellSize;
+        stats.bytesAllocated += sizeClass.cellSize;
+    } else {
+        header = static_cast<HeapHeader *>(calloc(1, total));
+        if (!header){
+            outOfMemory(size);
+        }
+        largeObjects.insert(header);
+        stats.largeObjects++;
+        stats.bytesInUse += total;
+        stats.bytesReserved += total;
+        stats.bytesAllocated += total;
+    }
+    header->kind = static_cast<uint32_t>(kind);
+    header->size = size;
+    return header->payload();
+}
+
+bool GCHeap::mark(void *payload){
+    HeapHeader *header = HeapHeader::of(payload);
+    if (isLarge(header)){
+        bool wasMarked = header->marked;
+        header->marked = 1;
+        return !wasMarked;
+    }
+    Block *block = Block::of(header);
+    size_t index = block->cellIndex(header);
+    uint64_t bit = uint64_t(1) << (index % 64);
+    bool wasMarked = block->markBits[index / 64] & bit;
+    block->markBits[index / 64] |= bit;
+    return !wasMarked;
+}
+
+bool GCHeap::isMarked(void *payload) const{
+    HeapHeader *header = HeapHeader::of(payload);
+    if (isLarge(header)){
+        return header->marked;
+    }
+    Block *block = Block::of(header);
+    size_t index = block->cellIndex(header);
+    return block->markBits[index / 64] & (uint64_t(1) << (index % 64));
+}
+
+bool GCHeap::contains(const void *payload) const{
+    HeapHeader *header = HeapHeader::of(const_cast<void *>(payload));
+    if (largeObjects.count(header)){
+        return true;
+    }
+    const Block *block = Block::of(header);
+    if (!allBlocks.count(block)){
+        return false;
+    }
+    const char *cells = reinterpret_cast<const char *>(block) + CellsOffset;
+    const char *cell = reinterpret_cast<const char *>(header);
+    if (cell < cells || (cell - cells) % block->cellSize != 0){
+        return false;
+    }
+    size_t index = (cell - cells) / block->cellSize;
+    return index < block->bumpIndex && (block->liveBits[index / 64] & (uint64_t(1) << (index % 64)));
+}
+
+size_t GCHeap::allocationSize(void *payload) const{
+    HeapHeader *header = HeapHeader::of(payload);
+    if (isLarge(header)){
+        return alignUp(sizeof(HeapHeader) + header->size, CellAlignment);
+    }
+    return Block::of(header)->cellSize;
+}
+
+// Keeps the marked cells, then threads every other cell handed out so far
+// onto the free list, lowest address first so allocation stays sequential.
+// Touches nothing but the block, so blocks can be swept in parallel. Returns
+// the bytes freed.
+size_t GCHeap::sweepBlock(Block *block){
+    size_t words = (block->bumpIndex + 63) / 64;
+    uint32_t liveCells = 0;
+    for (size_t i = 0; i < words; i++){
+        block->liveBits[i] &= block->markBits[i];
+        block->markBits[i] = 0;
+        liveCells += __builtin_popcountll(block->liveBits[i]);
+    }
+    size_t freedBytes = size_t(block->liveCells - liveCells) * block->cellSize;
+    block->liveCells = liveCells;
+    if (liveCells == 0){
+        // Released by the caller
+        return freedBytes;
+    }
+
+    FreeCell **tail = &block->freeList;
+    for (size_t i = 0; i < words; i++){
+        uint64_t freeBits = ~block->liveBits[i];
+        while (freeBits){
+            size_t index = i * 64 + __builtin_ctzll(freeBits);
+            freeBits &= freeBits - 1;
+            if (index >= block->bumpIndex){
+                break;
+            }
+            FreeCell *cell = reinterpret_cast<FreeCell *>(block->cells() + index * block->cellSize);
+            *tail = cell;
+            tail = &cell->next;
+        }
+    }
+    *tail = nullptr;
+    return freedBytes;
+}
+
+// Hands every block and large object to the sweep; allocation starts over
+// in new blocks
+void GCHeap::detachForSweep(){
+    sweepBlocks.reserve(stats.blocks);
+    for (auto &sizeClass : sizeClasses){
+        sweepBlocks.insert(sweepBlocks.end(), sizeClass.blocks.begin(), sizeClass.blocks.end());
+        sizeClass.blocks.clear();
+        sizeClass.allocationCursor = 0;
+    }
+    sweepLargeObjects.swap(largeObjects);
+    released = Stats();
+}
+
+// Runs on the sweeping thread: touches only the detached objects, the
+// released counts and, under its lock, allBlocks
+void GCHeap::sweepDetached(){
+    std::atomic<size_t> freedBytes{0};
+    auto sweepTask = [&](size_t index){
+        freedBytes += sweepBlock(sweepBlocks[index]);
+    };
+    if (sweepBlocks.size() >= ParallelSweepBlocks){
+        GCWorkers::instance().parallelFor(sweepBlocks.size(), sweepTask);
+    } else {
+        for (size_t index = 0; index < sweepBlocks.size(); index++){
+            sweepTask(index);
+        }
+    }
+    released.bytesInUse += freedBytes;
+
+    // Empty blocks go back to the system rather than idling in one class.
+    // They leave allBlocks before they are freed, so a new block at the same
+    // address cannot be dropped from it.
+    std::vector<void *> freed;
+    size_t kept = 0;
+    {
+        std::lock_guard<std::mutex> lock(allBlocksMutex);
+        for (Block *block : sweepBlocks){
+            if (block->liveCells == 0){
+                allBlocks.erase(block);
+                freed.push_back(block);
+                released.blocks++;
+                released.bytesReserved += BlockSize;
+            } else {
+                sweepBlocks[kept++] = block;
+            }
+        }
+    }
+    sweepBlocks.resize(kept);
+
+    for (auto it = sweepLargeObjects.begin(); it != sweepLargeObjects.end();){
+        HeapHeader *header = *it;
+        if (header->marked){
+            header->marked = 0;
+            ++it;
+        } else {
+            size_t total = alignUp(sizeof(HeapHeader) + header->size, CellAlignment);
+            released.bytesInUse += total;
+            released.bytesReserved += total;
+            released.largeObjects++;
+            freed.push_back(header);
+            it = sweepLargeObjects.erase(it);
+        }
+    }
+
+    auto releaseTask = [&](size_t index){
+        free(freed[index]);
+    };
+    if (freed.size() >= ParallelSweepBlocks){
+        GCWorkers::instance().parallelFor(freed.size(), releaseTask);
+    } else {
+        for (size_t index = 0; index < freed.size(); index++){
+            releaseTask(index);
+        }
+    }
+}
+
+// Puts the surviving blocks back in their size classes, ahead of the blocks
+// allocated during the sweep so their free cells are used first
+void GCHeap::reattachSwept(){
+    std::vector<std::vector<Block *>> survivors(sizeClasses.size());
+    for (Block *block : sweepBlocks){
+        survivors[block->sizeClass].push_back(block);
+    }
+    for (size_t classIndex = 0; classIndex < sizeClasses.size(); classIndex++){
+        SizeClass &sizeClass = sizeClasses[classIndex];
+        if (!survivors[classIndex].empty()){
+            sizeClass.blocks.insert(sizeClass.blocks.begin(), survivors[classIndex].begin(), survivors[classIndex].end());
+        }
+        sizeClass.allocationCursor = 0;
+    }
+    if (sweepLargeObjects.size() > largeObjects.size()){
+        sweepLargeObjects.swap(largeObjects);
+    }
+    largeObjects.insert(sweepLargeObjects.begin(), sweepLargeObjects.end());
+    sweepBlocks.clear();
+    sweepLargeObjects.clear();
+
+    stats.blocks -= released.blocks;
+    stats.largeObjects -= released.largeObjects;
+    stats.bytesInUse -= released.bytesInUse;
+    stats.bytesFreed += released.bytesInUse;
+    stats.bytesReserved -= released.bytesReserved;
+}
+
+void GCHeap::sweep(){
+    finishSweep(true);
+    detachForSweep();
+    sweepDetached();
+    reattachSwept();
+}
+
+void GCHeap::startSweep(){
+    finishSweep(true);
+    detachForSweep();
+    sweepDone = false;
+    sweeper = std::thread([this]{
+        sweepDetached();
+        sweepDone.store(true, std::memory_order_release);
+    });
+}
+
+bool GCHeap::finishSweep(bool wait){
+    if (!sweeper.joinable()){
+        return true;
+    }
+    if (!wait && !sweepDone.load(std::memory_order_acquire)){
+        return false;
+    }
+    sweeper.join();
+    reattachSwept();
+    return true;
+}
@@ -1,61 +1,202 @@
-#include <unordered_set>
-#include <vector>
-#include <memory>
-#include <iostream>
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include "include/Array.h"
+#include "include/Strings.h"
 #include "include/GCManager.h"
+#include "include/Log.h"
+#include "include/Runtime.h"
 
-void GCManager::addObject(GCObject* obj){
-    obj->marked = false;
-    objects.insert(obj);
+// Bound to std::max's reference parameters, so it needs a definition
+const size_t GCManager::MinCollectionThreshold;
+size_t GCManager::defaultNurserySize = 2 * 1024 * 1024;
+bool GCManager::defaultConcurrentSweep = false;
+int GCManager::defaultGrowthPercent = 100;
+size_t GCManager::defaultHeapLimit = 0;
+
+GCManager::~GCManager(){
+    if (collectionRequested) {
+        dnm_gc_requested--;
+    }
+    heap.finishSweep(true);
+    const PauseHistogram& pauses = telemetry.pauses;
+    if (pauses.pauses) {
+        DNM_LOG(GC, INFO) << collections << " collections, " << fullCollections << " full, pauses p50 "
+                          << pauses.percentile(50) << " us, p99 " << pauses.percentile(99) << " us, max "
+                          << pauses.maxMicroseconds << " us, total " << pauses.totalMicroseconds / 1000 << " ms";
+        if (Log::isEnabled(Log::GC, Log::DEBUG)) {
+            for (int bucket = 0; bucket < PauseHistogram::Buckets; bucket++) {
+                if (pauses.counts[bucket]) {
+                    DNM_LOG(GC, DEBUG) << "pauses under " << std::ldexp(1.0, bucket) << " us: " << pauses.counts[bucket];
+                }
+            }
+        }
+    }
+    if (GCTelemetry::dumpFormat == GCTelemetry::TEXT) {
+        getTelemetry().writeText(std::cerr, heap.getStats());
+    } else if (GCTelemetry::dumpFormat == GCTelemetry::JSON) {
+        getTelemetry().writeJSON(std::cerr, heap.getStats());
+    }
 }
 
-void GCManager::addRoot(GCObject* root){
-    roots.push_back(root);
+GCTelemetry GCManager::getTelemetry() const {
+    GCTelemetry snapshot = telemetry;
+    snapshot.bytesFreed = youngBytesFreed + heap.getStats().bytesFreed;
+    return snapshot;
 }
 
-void GCManager::removeRoot(GCObject* root){
-    roots.erase(
-      std::remove(roots.begin(), roots.end(), root),
-      roots.end()
-    );
+void GCManager::requestCollection(){
+    collectionRequested = true;
+    dnm_gc_requested++;
 }
 
-void GCManager::collectGarbage() {
-    mark();
-    sweep();
+// Old generation size at which to collect it next: once it has grown by
+// growthPercent of what survived, but early enough to stay within the heap limit
+size_t GCManager::nextThreshold(size_t liveBytes) const {
+    size_t threshold = SIZE_MAX;
+    if (growthPercent >= 0) {
+        threshold = std::max(MinCollectionThreshold, liveBytes + liveBytes * growthPercent / 100);
+    }
+    if (heapLimit) {
+        size_t nurseryBytes = nursery.getCapacity();
+        threshold = std::min(threshold, heapLimit > nurseryBytes ? heapLimit - nurseryBytes : 0);
+    }
+    return threshold;
 }
 
-void GCManager::mark() {
-    for (auto root : roots) {
-        markObject(root);
+// Large objects, and everything once the nursery is full until the next
+// collection empties it
+void* GCManager::allocateOld(HeapKind kind, size_t size){
+    if (heapLimit && size > heapLimit) {
+        std::cerr << "Heap limit of " << heapLimit << " bytes exceeded allocating " << size << " bytes\n";
+        runtimeError();
+    }
+    if (nursery.accepts(size)) {
+        if (!nursery.isReserved()) {
+            nursery.reserve();
+            if (void* payload = nursery.allocate(kind, size)) {
+                return payload;
+            }
+        }
+        if (!collectionRequested) {
+            requestCollection();
+        }
+    }
+    void* payload = heap.allocate(kind, size);
+    if (oldGenerationBytes() >= collectionThreshold && !collectionRequested) {
+        requestCollection();
     }
+    return payload;
 }
 
-void GCManager::sweep() {
-    
-    for (auto it = objects.begin(); it != objects.end();) {
-        
-        if (!(*it)->marked) {
-            
-            delete *it;
-            
-            it = objects.erase(it);
-            
+// Calls visit with the payload of the object each root refers to and makes
+// the root refer to the payload visit returns. Slots may also hold inline
+// bignums and strings, which are skipped, arrays on the stack and string literals.
+template <typename Visit>
+void GCManager::updateRoots(Visit visit){
+    static_assert(sizeof(StringInfo) == sizeof(ArrayInfo), "string roots are updated like array roots");
+    auto update = [&](uint64_t& word, HeapKind kind) {
+        // Odd words hold their number or string inline
+        if (!word || (word & 1)) {
+            return;
+        }
+        if (kind == HeapKind::Bignum) {
+            word = reinterpret_cast<uint64_t>(visit(reinterpret_cast<void*>(word)));
         } else {
-            
-            (*it)->marked = false;
-            ++it;
+            // Arrays and strings point past the info at the start of their payload
+            void* payload = ArrayInfo::of(reinterpret_cast<void*>(word));
+            word = reinterpret_cast<uint64_t>(static_cast<ArrayInfo*>(visit(payload)) + 1);
+        }
+    };
+    for (ShadowFrame* frame = topFrame; frame; frame = frame->previous) {
+        uint64_t* slots = frame->slots();
+        for (uint32_t i = 0; i < frame->bignumSlots; i++) {
+            update(slots[i], HeapKind::Bignum);
+        }
+        for (uint32_t i = frame->bignumSlots; i < frame->bignumSlots + frame->arraySlots; i++) {
+            update(slots[i], HeapKind::Array);
         }
     }
-    
+    for (auto& [slot, kind] : globalRoots) {
+        update(*static_cast<uint64_t*>(slot), kind);
+    }
 }
 
-void GCManager::markObject(GCObject* obj) {
-    
-    if (!obj || obj->marked) return;
+void GCManager::collectGarbage(){
+    using Clock = std::chrono::steady_clock;
+    auto microsecondsSince = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    };
+    auto start = Clock::now();
+    // Take back what a concurrent sweep has finished with, without waiting for it
+    heap.finishSweep(false);
+    if (nursery.isReserved()) {
+        size_t youngBytes = nursery.getBytesInUse();
+        size_t oldBytes = heap.getStats().bytesAllocated;
+        updateRoots([&](void* payload) {
+            if (!nursery.contains(payload)) {
+                return payload;
+            }
+            HeapHeader* header = HeapHeader::of(payload);
+            if (header->kind != static_cast<uint32_t>(HeapKind::Forwarded)) {
+                youngBytes -= (sizeof(HeapHeader) + header->size + GCHeap::CellAlignment - 1) & ~(GCHeap::CellAlignment - 1);
+            }
+            return nursery.evacuate(payload, heap);
+        });
+        nursery.reset();
+        youngBytesFreed += youngBytes;
+        telemetry.bytesPromoted += heap.getStats().bytesAllocated - oldBytes;
+        telemetry.phases[GCTelemetry::MINOR].record(microsecondsSince(start));
+    }
+    collections++;
 
-    obj->marked = true;
+    bool overLimit = false;
+    if (oldGenerationBytes() >= collectionThreshold) {
+        auto markStart = Clock::now();
+        heap.finishSweep(true);
+        size_t liveBytes = 0;
+        for (auto& objects : telemetry.live) {
+            objects = GCTelemetry::Objects();
+        }
+        updateRoots([&](void* payload) {
+            if (heap.contains(payload) && heap.mark(payload)) {
+                size_t bytes = heap.allocationSize(payload);
+                GCTelemetry::Objects& objects = telemetry.live[HeapHeader::of(payload)->kind];
+                objects.count++;
+                objects.bytes += bytes;
+                liveBytes += bytes;
+            }
+            return payload;
+        });
+        telemetry.phases[GCTelemetry::MARK].record(microsecondsSince(markStart));
+        auto sweepStart = Clock::now();
+        if (concurrentSweep) {
+            heap.startSweep();
+        } else {
+            heap.sweep();
+        }
+        telemetry.phases[GCTelemetry::SWEEP].record(microsecondsSince(sweepStart));
+        fullCollections++;
+        liveBytesAtMark = liveBytes;
+        allocatedAtMark = heap.getStats().bytesAllocated;
+        collectionThreshold = nextThreshold(liveBytes);
+        if (heapLimit && liveBytes + nursery.getCapacity() > heapLimit) {
+            overLimit = true;
+        }
+    }
 
-    obj->traceReferences([this](GCObject* child) { markObject(child); });
+    if (collectionRequested) {
+        collectionRequested = false;
+        dnm_gc_requested--;
+    }
+    telemetry.sampleHeap(oldGenerationBytes());
+    telemetry.pauses.record(microsecondsSince(start));
+    // Raised once the collection is complete, so a REPL session can go on
+    // with this heap after the input that filled it
+    if (overLimit) {
+        std::cerr << "Heap limit of " << heapLimit << " bytes exceeded: " << liveBytesAtMark
+                  << " bytes still referenced, with a nursery of " << nursery.getCapacity() << " bytes\n";
+        runtimeError();
+    }
 }
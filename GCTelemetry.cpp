@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include "include/GCTelemetry.h"
+
+GCTelemetry::Format GCTelemetry::dumpFormat = GCTelemetry::NONE;
+
+static const char *phaseNames[GCTelemetry::PHASE_COUNT] = {"minor", "mark", "sweep"};
+
+// Object kinds with a name, the others are never counted
+static const HeapKind reportedKinds[] = {HeapKind::Bignum, HeapKind::Array, HeapKind::String};
+static const char *kindNames[GCTelemetry::Kinds] = {"", "bignum", "array", "string"};
+
+void PauseHistogram::record(double microseconds){
+    int bucket = microseconds < 1 ? 0 : std::min(Buckets - 1, int(std::log2(microseconds)) + 1);
+    counts[bucket]++;
+    pauses++;
+    totalMicroseconds += microseconds;
+    maxMicroseconds = std::max(maxMicroseconds, microseconds);
+}
+
+double PauseHistogram::percentile(double percent) const{
+    uint64_t wanted = uint64_t(std::ceil(pauses * percent / 100));
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < Buckets; bucket++){
+        seen += counts[bucket];
+        if (seen >= wanted && seen){
+            return std::min(maxMicroseconds, std::ldexp(1.0, bucket));
+        }
+    }
+    return maxMicroseconds;
+}
+
+const char *GCTelemetry::phaseName(Phase phase){
+    return phaseNames[phase];
+}
+
+void GCTelemetry::sampleHeap(size_t bytes){
+    if (++samplesSkipped < sampleStride){
+        return;
+    }
+    samplesSkipped = 0;
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    heapSizes.push_back({milliseconds, bytes});
+    if (heapSizes.size() == MaxHeapSamples){
+        for (size_t i = 1; i < MaxHeapSamples / 2; i++){
+            heapSizes[i] = heapSizes[2 * i];
+        }
+        heapSizes.resize(MaxHeapSamples / 2);
+        sampleStride *= 2;
+    }
+}
+
+static void writeTextRow(std::ostream &out, const char *name, const PauseHistogram &pauses){
+    out << "  " << std::left << std::setw(7) << name << std::right << std::setw(7) << pauses.pauses
+        << std::setw(10) << pauses.totalMicroseconds / 1000 << std::setw(9) << pauses.percentile(50)
+        << std::setw(9) << pauses.percentile(90) << std::setw(9) << pauses.percentile(99)
+        << std::setw(9) << pauses.maxMicroseconds << "\n";
+}
+
+void GCTelemetry::writeText(std::ostream &out, const GCHeap::Stats &heap) const{
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(1);
+    out << "GC: " << pauses.pauses << " collections, " << phases[MARK].pauses << " full\n";
+    out << "  pause    count  total ms   p50 us   p90 us   p99 us   max us\n";
+    writeTextRow(out, "all", pauses);
+    for (int phase = 0; phase < PHASE_COUNT; phase++){
+        writeTextRow(out, phaseNames[phase], phases[phase]);
+    }
+    out << "Allocated:";
+    for (HeapKind kind : reportedKinds){
+        const Objects &objects = allocated[static_cast<uint32_t>(kind)];
+        out << " " << kindNames[static_cast<uint32_t>(kind)] << " " << objects.count << " objects, " << objects.bytes << " bytes;";
+    }
+    out << "\nFreed: " << bytesFreed << " bytes, promoted " << bytesPromoted << " bytes\n";
+    out << "Live at the last full collection:";
+    for (HeapKind kind : reportedKinds){
+        const Objects &objects = live[static_cast<uint32_t>(kind)];
+        out << " " << kindNames[static_cast<uint32_t>(kind)] << " " << objects.count << " objects, " << objects.bytes << " bytes;";
+    }
+    out << "\nHeap: " << heap.bytesInUse << " bytes in use, " << heap.bytesReserved << " reserved\n";
+    if (!heapSizes.empty()){
+        out << "Old generation after collections (ms: bytes):";
+        for (size_t i = 0; i < heapSizes.size(); i++){
+            out << (i % 6 ? "  " : "\n  ") << heapSizes[i].milliseconds << ": " << heapSizes[i].bytes;
+        }
+        out << "\n";
+    }
+    out.flags(flags);
+}
+
+static void writeJSONPauses(std::ostream &out, const PauseHistogram &pauses){
+    out << "{\"count\": " << pauses.pauses << ", \"totalMs\": " << pauses.totalMicroseconds / 1000
+        << ", \"p50Us\": " << pauses.percentile(50) << ", \"p90Us\": " << pauses.percentile(90)
+        << ", \"p99Us\": " << pauses.percentile(99) << ", \"maxUs\": " << pauses.maxMicroseconds << "}";
+}
+
+static void writeJSONObjects(std::ostream &out, const GCTelemetry::Objects *objects){
+    out << "{";
+    const char *separator = "";
+    for (HeapKind kind : reportedKinds){
+        const GCTelemetry::Objects &ofKind = objects[static_cast<uint32_t>(kind)];
+        out << separator << "\"" << kindNames[static_cast<uint32_t>(kind)] << "\": {\"count\": " << ofKind.count
+            << ", \"bytes\": " << ofKind.bytes << "}";
+        separator = ", ";
+    }
+    out << "}";
+}
+
+void GCTelemetry::writeJSON(std::ostream &out, const GCHeap::Stats &heap) const{
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(3);
+    out << "{\"collections\": " << pauses.pauses << ", \"fullCollections\": " << phases[MARK].pauses << ", \"pauses\": ";
+    writeJSONPauses(out, pauses);
+    out << ", \"phases\": {";
+    for (int phase = 0; phase < PHASE_COUNT; phase++){
+        out << (phase ? ", " : "") << "\"" << phaseNames[phase] << "\": ";
+        writeJSONPauses(out, phases[phase]);
+    }
+    out << "}, \"allocated\": ";
+    writeJSONObjects(out, allocated);
+    out << ", \"bytesFreed\": " << bytesFreed << ", \"bytesPromoted\": " << bytesPromoted << ", \"live\": ";
+    writeJSONObjects(out, live);
+    out << ", \"heap\": {\"bytesInUse\": " << heap.bytesInUse << ", \"bytesReserved\": " << heap.bytesReserved
+        << ", \"oldGenerationSamples\": [";
+    for (size_t i = 0; i < heapSizes.size(); i++){
+        out << (i ? ", " : "") << "{\"ms\": " << heapSizes[i].milliseconds << ", \"bytes\": " << heapSizes[i].bytes << "}";
+    }
+    out << "]}}\n";
+    out.flags(flags);
+}
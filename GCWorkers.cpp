@@ -0,0 +1,76 @@
+#include <algorithm>
+#include "include/GCWorkers.h"
+
+unsigned GCWorkers::defaultThreads = std::max(1u, std::thread::hardware_concurrency());
+
+GCWorkers& GCWorkers::instance(){
+    static GCWorkers workers(defaultThreads);
+    return workers;
+}
+
+GCWorkers::GCWorkers(unsigned threads) : threads(std::max(1u, threads)){
+    for (unsigned i = 1; i < this->threads; i++){
+        workers.emplace_back(&GCWorkers::workerLoop, this);
+    }
+}
+
+GCWorkers::~GCWorkers(){
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (auto &worker : workers){
+        worker.join();
+    }
+}
+
+void GCWorkers::runTasks(){
+    for (size_t index = nextTask++; index < taskCount; index = nextTask++){
+        task(context, index);
+    }
+}
+
+void GCWorkers::run(size_t count, TaskFunction function, void* functionContext){
+    std::unique_lock<std::mutex> job(jobMutex, std::try_to_lock);
+    if (workers.empty() || count < 2 || !job.owns_lock()){
+        for (size_t index = 0; index < count; index++){
+            function(functionContext, index);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        task = function;
+        context = functionContext;
+        taskCount = count;
+        nextTask = 0;
+        busyWorkers = workers.size();
+        generation++;
+    }
+    jobReady.notify_all();
+    runTasks();
+
+    // The job's state must outlive every worker still looking at it
+    std::unique_lock<std::mutex> lock(stateMutex);
+    jobDone.wait(lock, [this] { return busyWorkers == 0; });
+}
+
+void GCWorkers::workerLoop(){
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(stateMutex);
+    while (true){
+        jobReady.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping){
+            return;
+        }
+        seen = generation;
+        lock.unlock();
+        runTasks();
+        lock.lock();
+        if (--busyWorkers == 0){
+            jobDone.notify_one();
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#include <fstream>
+#include <mutex>
+#include "include/Log.h"
+
+Log::Level Log::levels[Log::CATEGORY_COUNT] = {};
+std::string Log::dumpPaths[Log::ARTIFACT_COUNT];
+bool Log::dumpStarted[Log::ARTIFACT_COUNT] = {};
+
+static const char *categoryNames[Log::CATEGORY_COUNT] = {"lexer", "parser", "codegen", "jit", "gc"};
+static const char *levelNames[] = {"off", "info", "debug", "trace"};
+
+static std::mutex outputMutex;
+
+const char *Log::categoryName(Category category)
+{
+    return categoryNames[category];
+}
+
+bool Log::configure(const std::string &spec)
+{
+    std::stringstream entries(spec);
+    std::string entry;
+    while (std::getline(entries, entry, ','))
+    {
+        std::string name = entry, levelName = "debug";
+        size_t equal = entry.find('=');
+        if (equal != std::string::npos)
+        {
+            name = entry.substr(0, equal);
+            levelName = entry.substr(equal + 1);
+        }
+
+        int level = -1;
+        for (int i = OFF; i <= TRACE; i++)
+        {
+            if (levelName == levelNames[i])
+            {
+                level = i;
+            }
+        }
+        if (level < 0)
+        {
+            std::cerr << "Unknown log level: " << levelName << "\n";
+            return false;
+        }
+
+        bool found = false;
+        for (int i = 0; i < CATEGORY_COUNT; i++)
+        {
+            if (name == "all" || name == categoryNames[i])
+            {
+                levels[i] = static_cast<Level>(level);
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            std::cerr << "Unknown log category: " << name << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+void Log::writeDump(Artifact artifact, const std::string &text)
+{
+    std::lock_guard<std::mutex> lock(outputMutex);
+    std::ofstream file(dumpPaths[artifact], dumpStarted[artifact] ? std::ios::app : std::ios::trunc);
+    if (!file)
+    {
+        std::cerr << "Cannot write " << dumpPaths[artifact] << "\n";
+        return;
+    }
+    file << text;
+    dumpStarted[artifact] = true;
+}
+
+Log::Line::Line(Category category)
+{
+    stream << "[" << categoryName(category) << "] ";
+}
+
+Log::Line::~Line()
+{
+    stream << "\n";
+    std::lock_guard<std::mutex> lock(outputMutex);
+    std::cerr << stream.str();
+}
@@ -0,0 +1,43 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "include/Nursery.h"
+#include "include/Runtime.h"
+
+Nursery::~Nursery(){
+    free(start);
+}
+
+bool Nursery::accepts(size_t size) const{
+    return size <= MaxObjectSize - sizeof(HeapHeader) && sizeof(HeapHeader) + size <= capacity;
+}
+
+void Nursery::reserve(){
+    start = static_cast<char *>(aligned_alloc(GCHeap::CellAlignment, capacity));
+    if (!start){
+        std::cerr << "Out of memory reserving a nursery of " << capacity << " bytes\n";
+        runtimeError();
+    }
+    memset(start, 0, capacity);
+    top = start;
+    end = start + capacity;
+}
+
+void *Nursery::evacuate(void *payload, GCHeap &oldGeneration){
+    HeapHeader *header = HeapHeader::of(payload);
+    // A moved object keeps the address of its copy at the start of its payload
+    if (header->kind == static_cast<uint32_t>(HeapKind::Forwarded)){
+        return *static_cast<void **>(payload);
+    }
+    void *copy = oldGeneration.allocate(static_cast<HeapKind>(header->kind), header->size);
+    memcpy(copy, payload, header->size);
+    header->kind = static_cast<uint32_t>(HeapKind::Forwarded);
+    *static_cast<void **>(payload) = copy;
+    return copy;
+}
+
+void Nursery::reset(){
+    // Cleared here in one go rather than object by object in allocate
+    memset(start, 0, top - start);
+    top = start;
+}
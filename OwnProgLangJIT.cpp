@@ -1,6 +1,7 @@
 #include "include/OwnProgLangJIT.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Transforms/Scalar.h"
+#include "include/Log.h"
 
 llvm::Expected<std::unique_ptr<llvm::orc::OwnProgLangJIT>> llvm::orc::OwnProgLangJIT::Create() {
     auto EPC = SelfExecutorProcessControl::Create();
@@ -23,22 +24,45 @@ llvm::Error llvm::orc::OwnProgLangJIT::addModule(ThreadSafeModule TSM, ResourceT
     if (!RT)
         RT = MainJD.getDefaultResourceTracker();
 
-    llvm::errs() << "Adding module to JIT...\n";
+    DNM_LOG(JIT, DEBUG) << "Adding module to JIT...";
 
     if (auto Err = TransformLayer.add(RT, std::move(TSM))) {
         llvm::errs() << "Failed to add module: " << llvm::toString(std::move(Err)) << "\n";
         return Err;
     }
 
-    llvm::errs() << "Module successfully added.\n";
+    DNM_LOG(JIT, DEBUG) << "Module successfully added.";
     return llvm::Error::success();
 }
 
+llvm::Error llvm::orc::OwnProgLangJIT::removeModule(ResourceTrackerSP RT) {
+    if (!RT)
+        return llvm::Error::success();
+
+    return RT->remove();
+}
+
+llvm::Expected<llvm::orc::JITDylib &> llvm::orc::OwnProgLangJIT::createScriptDylib(StringRef Name) {
+    auto JD = ES->createJITDylib((Name + "#" + Twine(ScriptCount++)).str());
+    if (!JD)
+        return JD.takeError();
+
+    JD->addToLinkOrder(MainJD);
+    return *JD;
+}
+
+llvm::Error llvm::orc::OwnProgLangJIT::removeScriptDylib(JITDylib &JD) {
+    return ES->removeJITDylib(JD);
+}
+
 llvm::Expected<llvm::orc::ExecutorSymbolDef> llvm::orc::OwnProgLangJIT::lookup(StringRef Name) {
-    auto Sym = ES->lookup({&MainJD}, Mangle(Name.str()));
+    return lookup(MainJD, Name);
+}
+
+llvm::Expected<llvm::orc::ExecutorSymbolDef> llvm::orc::OwnProgLangJIT::lookup(JITDylib &JD, StringRef Name) {
+    auto Sym = ES->lookup({&JD}, Mangle(Name.str()));
     if (!Sym) {
         llvm::errs() << "Error: Symbol '" << Name << "' not found.\n";
-        llvm::errs() << llvm::toString(Sym.takeError()) << "\n";
         return Sym.takeError();
     }
     
@@ -56,8 +80,15 @@ llvm::Expected<llvm::orc::ThreadSafeModule> llvm::orc::OwnProgLangJIT::optimizeM
         for (auto &F : M)
             FPM->run(F);
 
-        llvm::errs() << "Optimized IR:\n";
-        M.print(llvm::errs(), nullptr);
+        if (Log::isDumpEnabled(Log::OPTIMIZED_IR) || Log::isEnabled(Log::JIT, Log::TRACE)) {
+            std::string IR;
+            llvm::raw_string_ostream OS(IR);
+            M.print(OS, nullptr);
+            OS.flush();
+            if (Log::isDumpEnabled(Log::OPTIMIZED_IR))
+                Log::writeDump(Log::OPTIMIZED_IR, IR);
+            DNM_LOG(JIT, TRACE) << "Optimized IR:\n" << IR;
+        }
     });
     return std::move(TSM);
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "include/Parser.h"
+#include "include/Log.h"
 #include <string>
 
 using namespace std;
@@ -57,7 +58,7 @@ unique_ptr<Token> Parser::consumeToken(TokenType type, string errorMessage)
 
 unique_ptr<Statement> Parser::statement()
 {
-    if (matchToken({INT, BIGINT, FLOAT, STR, CHAR, BOOL})) return variableDeclaration();
+    if (matchToken({INT, BIGINT, BIGNUM, FLOAT, STR, CHAR, BOOL})) return variableDeclaration();
     if (matchToken({ARRAY})) return arrayDeclaration();
     if (matchToken({PRINT})) return print();
     if (matchToken({LEFT_BRACE})) return block();
@@ -84,23 +85,100 @@ unique_ptr<Statement> Parser::variableDeclaration()
     return make_unique<VariableDeclaration>(type, std::move(identifier), std::move(initValue));
 }
 
+// Literal value of an array initializer, looking through a leading minus
+template <typename Literal>
+static Literal *literalOf(Expression *expr, bool &negative){
+    negative = false;
+    if (auto unary = dynamic_cast<Unary*>(expr); unary && unary->_operator.type == MINUS){
+        negative = true;
+        expr = unary->operand.get();
+    }
+    return dynamic_cast<Literal*>(expr);
+}
+
+template <typename T>
+static void appendBytes(vector<uint8_t> &buffer, T value){
+    const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+// Bytes an element of the array type takes in memory, 0 if it cannot be packed
+static size_t packedElementSize(TokenType type){
+    switch (type){
+    case INT: return sizeof(int32_t);
+    case BIGINT: return sizeof(__int128);
+    case FLOAT: return sizeof(float);
+    case BOOL: return sizeof(uint8_t);
+    case CHAR: return sizeof(char);
+    default: return 0;
+    }
+}
+
+// Appends the initializer to the packed buffer in the in-memory layout of the
+// array's element type. Returns false when it is not a literal of that type.
+static bool packConstant(TokenType type, Expression *expr, vector<uint8_t> &buffer){
+    bool negative;
+    switch (type){
+    case INT:
+        if (auto literal = literalOf<IntegerLiteral>(expr, negative)){
+            appendBytes<int32_t>(buffer, negative ? -literal->value : literal->value);
+            return true;
+        }
+        return false;
+    case BIGINT:
+        if (auto literal = literalOf<IntegerLiteral>(expr, negative)){
+            appendBytes<__int128>(buffer, negative ? -__int128(literal->value) : __int128(literal->value));
+            return true;
+        }
+        return false;
+    case FLOAT:
+        if (auto literal = literalOf<FloatLiteral>(expr, negative)){
+            appendBytes<float>(buffer, negative ? -literal->value : literal->value);
+            return true;
+        }
+        return false;
+    case BOOL:
+        if (auto literal = dynamic_cast<BoolLiteral*>(expr)){
+            appendBytes<uint8_t>(buffer, literal->value);
+            return true;
+        }
+        return false;
+    case CHAR:
+        if (auto literal = dynamic_cast<CharLiteral*>(expr)){
+            appendBytes<char>(buffer, literal->value);
+            return true;
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
 unique_ptr<Statement> Parser::arrayDeclaration()
 {
     if (!matchToken({INT, BIGINT, FLOAT, STR, CHAR, BOOL})) std::cerr << "expect type";
     TokenType type = previousToken()->type;
     string varName = consumeToken(IDENTIFIER, "expect variable name")->value;
     auto identifier = make_unique<Identifier>(varName);
-    consumeToken(LEFT_SQUARE, "expect a '['");
-    if (currentToken()->type != NUMBER_INT){
-        std::cerr << "Size requires positive int value";
+    if (matchToken({EQUAL})){
+        // An array returned by a function
+        auto source = expression();
+        if (source == nullptr){
+            std::cerr << "expect primary expression";
+        }
+        consumeToken(SEMICOLON, "expect a ';'");
+        return make_unique<ArrayDeclaration>(type, std::move(identifier), std::move(source));
     }
-    int size = stoi(getToken()->value);
-    if (size < 0){
-        std::cerr << "Size requires positive int value";
+    consumeToken(LEFT_SQUARE, "expect a '['");
+    // Any integer expression, evaluated when the declaration runs
+    auto size = expression();
+    if (size == nullptr){
+        std::cerr << "expect array size";
     }
     consumeToken(RIGHT_SQUARE, "expect a ']'");
 
     vector<unique_ptr<Expression>> initValues;
+    vector<uint8_t> constantInit;
     if (matchToken({EQUAL})){
         consumeToken(LEFT_BRACE, "expect a '{'");
         if (!matchToken({RIGHT_BRACE})){
@@ -123,7 +201,25 @@ unique_ptr<Statement> Parser::arrayDeclaration()
         }
     }
     consumeToken(SEMICOLON, "expect a ';'");
-    return make_unique<ArrayDeclaration>(type, std::move(identifier), size, std::move(initValues));
+
+    // Literal initializers are kept as one packed buffer instead of a node
+    // each. Other entries stay in initValues and are zero in the buffer.
+    if (size_t elementSize = packedElementSize(type)){
+        bool hasConstant = false;
+        for (auto &initValue : initValues){
+            if (initValue && packConstant(type, initValue.get(), constantInit)){
+                initValue.reset();
+                hasConstant = true;
+            }
+            else {
+                constantInit.resize(constantInit.size() + elementSize);
+            }
+        }
+        if (!hasConstant){
+            constantInit.clear();
+        }
+    }
+    return make_unique<ArrayDeclaration>(type, std::move(identifier), std::move(size), std::move(initValues), std::move(constantInit));
 }
 
 unique_ptr<Statement> Parser::condition()
@@ -145,7 +241,7 @@ unique_ptr<Statement> Parser::forLoop()
     unique_ptr<Statement> initializer;
     if (matchToken({SEMICOLON})){
         initializer = nullptr;
-    } else if (matchToken({INT, BIGINT, FLOAT, STR, CHAR, BOOL})) {
+    } else if (matchToken({INT, BIGINT, BIGNUM, FLOAT, STR, CHAR, BOOL})) {
         initializer = variableDeclaration();
     } else {
         initializer = expressionStatement();
@@ -182,14 +278,18 @@ std::unique_ptr<Statement> Parser::prototypeFunction()
     string functionName = consumeToken(IDENTIFIER, "expect an identifier")->value;
     consumeToken(LEFT_PAREN, "expect a '('");
     vector<pair<TokenType, string>> functionArgs;
+    vector<bool> arrayArgs;
     if (!matchToken({RIGHT_PAREN})){
         while (true){
-            if (!matchToken({INT, BIGINT, FLOAT, STR, CHAR, BOOL})){
+            // Arrays are passed by reference
+            bool isArray = matchToken({ARRAY});
+            if (!matchToken({INT, BIGINT, BIGNUM, FLOAT, STR, CHAR, BOOL})){
                 std::cerr << "expect argument type";
             }
             TokenType argType = previousToken()->type;
             string argName = consumeToken(IDENTIFIER, "expect parameter name")->value;
             functionArgs.push_back({argType, argName});
+            arrayArgs.push_back(isArray);
             if (matchToken({COMMA})){
                 continue;
             }
@@ -203,11 +303,12 @@ std::unique_ptr<Statement> Parser::prototypeFunction()
     }
     
     consumeToken(RETURN_TYPE, "expect return type");
-    if (!matchToken({INT, BIGINT, FLOAT, STR, CHAR, BOOL, VOID})){
+    bool returnsArray = matchToken({ARRAY});
+    if (!matchToken({INT, BIGINT, BIGNUM, FLOAT, STR, CHAR, BOOL, VOID})){
         std::cerr << "expect return type";
     }
     auto returnType = previousToken()->type;
-    return make_unique<PrototypeFunction>(functionName, functionArgs, returnType);
+    return make_unique<PrototypeFunction>(functionName, functionArgs, returnType, arrayArgs, returnsArray);
 }
 
 unique_ptr<Statement> Parser::function()
@@ -445,7 +546,7 @@ vector<unique_ptr<ASTNode>> Parser::getASTNodeList()
 
 void Parser::parse()
 {
-    cout << "Size: " << tokenList.size() << endl;
+    DNM_LOG(PARSER, DEBUG) << "Parsing " << tokenList.size() << " tokens";
     while (currentToken()->type != EOF_TOKEN){
         unique_ptr<ASTNode> node;
         if (matchToken({FUNCTION})){
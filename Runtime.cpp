@@ -0,0 +1,227 @@
+#include <cstdarg>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "include/Runtime.h"
+
+static FileOutputSink stdoutSink(stdout);
+static thread_local OutputSink *currentSink = nullptr;
+
+// Big enough that a print-heavy script reaches the sink only every few
+// thousand lines
+static const size_t PrintBufferSize = 64 * 1024;
+
+struct PrintBuffer {
+    char data[PrintBufferSize];
+    size_t size = 0;
+
+    ~PrintBuffer() { drain(); }
+
+    void drain(){
+        if (size > 0){
+            getOutputSink().write(data, size);
+            size = 0;
+        }
+    }
+
+    // Returns room for at least `length` bytes at the end of the buffer
+    char *reserve(size_t length){
+        if (size + length > PrintBufferSize){
+            drain();
+        }
+        return data + size;
+    }
+
+    void append(const char *text, size_t length){
+        if (length > PrintBufferSize){
+            drain();
+            getOutputSink().write(text, length);
+            return;
+        }
+        memcpy(reserve(length), text, length);
+        size += length;
+    }
+};
+
+static thread_local PrintBuffer printBuffer;
+
+void setOutputSink(OutputSink *sink){
+    printBuffer.drain();
+    currentSink = sink;
+}
+
+OutputSink &getOutputSink(){
+    return currentSink ? *currentSink : stdoutSink;
+}
+
+void appendOutput(const char *data, size_t size){
+    printBuffer.append(data, size);
+}
+
+void flushOutput(){
+    printBuffer.drain();
+    getOutputSink().flush();
+}
+
+static thread_local std::jmp_buf *runtimeErrorJump = nullptr;
+
+std::jmp_buf *setRuntimeErrorJump(std::jmp_buf *jump){
+    std::jmp_buf *previous = runtimeErrorJump;
+    runtimeErrorJump = jump;
+    return previous;
+}
+
+void runtimeError(){
+    if (!runtimeErrorJump){
+        abort();
+    }
+    // Compiled code has no destructors to run on the way out. At worst a
+    // runtime function in between leaks a temporary buffer, e.g. a bignum
+    // quotient whose result did not fit in the heap limit.
+    std::longjmp(*runtimeErrorJump, 1);
+}
+
+static const char digitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// Writes the digits of `value` ending just before `end`, two at a time,
+// and returns the position of the first digit
+static char *formatUnsigned(uint64_t value, char *end){
+    while (value >= 100){
+        unsigned pair = static_cast<unsigned>(value % 100) * 2;
+        value /= 100;
+        *--end = digitPairs[pair + 1];
+        *--end = digitPairs[pair];
+    }
+    if (value >= 10){
+        unsigned pair = static_cast<unsigned>(value) * 2;
+        *--end = digitPairs[pair + 1];
+        *--end = digitPairs[pair];
+    } else {
+        *--end = static_cast<char>('0' + value);
+    }
+    return end;
+}
+
+static void printSigned(int64_t value){
+    char digits[24];
+    char *end = digits + sizeof(digits);
+    *--end = '\n';
+    uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    char *begin = formatUnsigned(magnitude, end);
+    if (value < 0){
+        *--begin = '-';
+    }
+    printBuffer.append(begin, digits + sizeof(digits) - begin);
+}
+
+// Up to 39 digits: the magnitude is split into base 10^19 chunks that each
+// fit in 64 bits, so only two 128-bit divisions are ever needed
+static void printSigned128(__int128 value){
+    const uint64_t chunkBase = 10000000000000000000ULL;
+    char digits[48];
+    char *end = digits + sizeof(digits);
+    *--end = '\n';
+    unsigned __int128 magnitude = value < 0 ? 0 - static_cast<unsigned __int128>(value)
+                                            : static_cast<unsigned __int128>(value);
+    char *begin = end;
+    while (magnitude >= chunkBase){
+        uint64_t chunk = static_cast<uint64_t>(magnitude % chunkBase);
+        magnitude /= chunkBase;
+        char *chunkEnd = begin;
+        begin = formatUnsigned(chunk, chunkEnd);
+        while (chunkEnd - begin < 19){
+            *--begin = '0';
+        }
+    }
+    begin = formatUnsigned(static_cast<uint64_t>(magnitude), begin);
+    if (value < 0){
+        *--begin = '-';
+    }
+    printBuffer.append(begin, digits + sizeof(digits) - begin);
+}
+
+static __int128 joinHalves(uint64_t low, int64_t high){
+    return static_cast<__int128>((static_cast<unsigned __int128>(static_cast<uint64_t>(high)) << 64) | low);
+}
+
+extern "C" int dnm_printf(const char *format, ...){
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    va_list retry;
+    va_copy(retry, args);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    if (length < 0){
+        va_end(retry);
+        return length;
+    }
+    if (static_cast<size_t>(length) < sizeof(buffer)){
+        printBuffer.append(buffer, length);
+    } else {
+        std::vector<char> large(length + 1);
+        vsnprintf(large.data(), large.size(), format, retry);
+        printBuffer.append(large.data(), length);
+    }
+    va_end(retry);
+    return length;
+}
+
+extern "C" void dnm_print_i32(int32_t value){
+    printSigned(value);
+}
+
+extern "C" void dnm_print_i64(int64_t value){
+    printSigned(value);
+}
+
+extern "C" void dnm_print_f64(double value){
+    // "%f" of the largest double is 317 characters plus the newline
+    const size_t maxLength = 320;
+    char *out = printBuffer.reserve(maxLength);
+    int length = snprintf(out, maxLength, "%f\n", value);
+    if (length > 0){
+        printBuffer.size += length;
+    }
+}
+
+extern "C" void dnm_print_char(int32_t value){
+    char *out = printBuffer.reserve(2);
+    out[0] = static_cast<char>(value);
+    out[1] = '\n';
+    printBuffer.size += 2;
+}
+
+extern "C" void dnm_print_i128(uint64_t low, int64_t high){
+    printSigned128(joinHalves(low, high));
+}
+
+extern "C" void dnm_i128_divrem(uint64_t lhsLow, int64_t lhsHigh, uint64_t rhsLow, int64_t rhsHigh, uint64_t *result){
+    __int128 lhs = joinHalves(lhsLow, lhsHigh);
+    __int128 rhs = joinHalves(rhsLow, rhsHigh);
+    __int128 quotient = lhs / rhs;
+    __int128 remainder = lhs - quotient * rhs;
+    result[0] = static_cast<uint64_t>(quotient);
+    result[1] = static_cast<uint64_t>(static_cast<unsigned __int128>(quotient) >> 64);
+    result[2] = static_cast<uint64_t>(remainder);
+    result[3] = static_cast<uint64_t>(static_cast<unsigned __int128>(remainder) >> 64);
+}
+
+extern "C" void dnm_division_error(int32_t overflow){
+    // Whatever the program printed so far comes before the error
+    flushOutput();
+    std::cerr << (overflow ? "Integer overflow in division\n" : "Division by zero\n");
+    runtimeError();
+}
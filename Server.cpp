@@ -0,0 +1,286 @@
+#include "include/Server.h"
+#include "include/CodeGenContext.h"
+#include "include/Lexer.h"
+#include "include/Parser.h"
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static const size_t MaxSourceSize = 64 * 1024 * 1024;
+
+static volatile sig_atomic_t stopRequested = 0;
+static int serverListenFd = -1;
+
+static void handleStopSignal(int){
+    stopRequested = 1;
+    // Wakes up the blocking accept() in run()
+    if (serverListenFd >= 0){
+        shutdown(serverListenFd, SHUT_RDWR);
+    }
+}
+
+static bool sendAll(int fd, const char *data, size_t size){
+    while (size > 0){
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (sent <= 0){
+            return false;
+        }
+        data += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+static bool readLine(int fd, std::string &line){
+    line.clear();
+    char c;
+    while (recv(fd, &c, 1, 0) == 1){
+        if (c == '\n'){
+            return true;
+        }
+        line.push_back(c);
+        if (line.size() > 4096){
+            return false;
+        }
+    }
+    return false;
+}
+
+static bool readExact(int fd, std::string &data, size_t size){
+    data.resize(size);
+    size_t received = 0;
+    while (received < size){
+        ssize_t n = recv(fd, &data[received], size - received, 0);
+        if (n <= 0){
+            return false;
+        }
+        received += n;
+    }
+    return true;
+}
+
+// Streams a script's output back to the client as OUT frames
+class SocketOutputSink : public OutputSink {
+    int fd;
+    std::string buffer;
+public:
+    SocketOutputSink(int fd) : fd(fd) {}
+    ~SocketOutputSink() override { flush(); }
+
+    void write(const char *data, size_t size) override {
+        buffer.append(data, size);
+        if (buffer.size() >= 4096){
+            flush();
+        }
+    }
+
+    void flush() override {
+        if (buffer.empty()){
+            return;
+        }
+        std::string header = "OUT " + std::to_string(buffer.size()) + "\n";
+        sendAll(fd, header.data(), header.size());
+        sendAll(fd, buffer.data(), buffer.size());
+        buffer.clear();
+    }
+};
+
+// Everything a worker writes to std::cerr while it serves a request, compile
+// errors as well as the program's runtime errors, is collected here and sent
+// to the client as an ERR frame. std::cerr is shared by all threads, so its
+// buffer looks up the thread's collection on every write; threads that are
+// not serving a request write through to the daemon's stderr.
+static thread_local std::string *requestErrors = nullptr;
+
+class RequestErrorBuffer : public std::streambuf {
+    std::streambuf *stderrBuffer;
+public:
+    RequestErrorBuffer(std::streambuf *stderrBuffer) : stderrBuffer(stderrBuffer) {}
+
+protected:
+    int overflow(int c) override {
+        if (traits_type::eq_int_type(c, traits_type::eof())){
+            return traits_type::not_eof(c);
+        }
+        char character = traits_type::to_char_type(c);
+        return xsputn(&character, 1) == 1 ? c : traits_type::eof();
+    }
+
+    std::streamsize xsputn(const char *data, std::streamsize size) override {
+        if (requestErrors){
+            requestErrors->append(data, size);
+            return size;
+        }
+        return stderrBuffer->sputn(data, size);
+    }
+
+    int sync() override {
+        return requestErrors ? 0 : stderrBuffer->pubsync();
+    }
+};
+
+int CompileServer::run(){
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0){
+        std::cerr << "Cannot create socket: " << strerror(errno) << "\n";
+        return 1;
+    }
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)){
+        std::cerr << "Socket path too long: " << socketPath << "\n";
+        return 1;
+    }
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    unlink(socketPath.c_str());
+
+    if (bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 ||
+        listen(listenFd, 128) < 0){
+        std::cerr << "Cannot listen on " << socketPath << ": " << strerror(errno) << "\n";
+        close(listenFd);
+        return 1;
+    }
+
+    serverListenFd = listenFd;
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, handleStopSignal);
+    signal(SIGTERM, handleStopSignal);
+
+    RequestErrorBuffer errorBuffer(std::cerr.rdbuf());
+    std::streambuf *stderrBuffer = std::cerr.rdbuf(&errorBuffer);
+    for (unsigned i = 0; i < workerCount; i++){
+        workers.emplace_back(&CompileServer::workerLoop, this);
+    }
+    std::cerr << "Listening on " << socketPath << " with " << workerCount << " workers\n";
+
+    while (!stopRequested){
+        int clientFd = accept(listenFd, nullptr, nullptr);
+        if (clientFd < 0){
+            if (errno == EINTR){
+                continue;
+            }
+            break;
+        }
+        std::lock_guard<std::mutex> lock(queueMutex);
+        pendingClients.push_back(clientFd);
+        queueReady.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+        queueReady.notify_all();
+    }
+    for (auto &worker : workers){
+        worker.join();
+    }
+    std::cerr.rdbuf(stderrBuffer);
+    serverListenFd = -1;
+    close(listenFd);
+    unlink(socketPath.c_str());
+    return 0;
+}
+
+void CompileServer::workerLoop(){
+    while (true){
+        int clientFd;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueReady.wait(lock, [this] { return stopping || !pendingClients.empty(); });
+            if (pendingClients.empty()){
+                return;
+            }
+            clientFd = pendingClients.front();
+            pendingClients.pop_front();
+        }
+        handleClient(clientFd);
+        close(clientFd);
+    }
+}
+
+void CompileServer::handleClient(int clientFd){
+    std::string request, name, sourceCode, errors;
+    int status = 1;
+    requestErrors = &errors;
+    if (readLine(clientFd, request)){
+        if (request.compare(0, 4, "RUN ") == 0){
+            name = request.substr(4);
+            std::ifstream inputFile(name);
+            if (inputFile.is_open()){
+                std::stringstream ss;
+                ss << inputFile.rdbuf();
+                sourceCode = ss.str();
+                status = compileAndRun(name, sourceCode, clientFd);
+            } else {
+                std::cerr << "Error opening file " << name << "\n";
+            }
+        } else if (request.compare(0, 7, "SOURCE ") == 0){
+            name = "source";
+            size_t length = strtoul(request.c_str() + 7, nullptr, 10);
+            if (length <= MaxSourceSize && readExact(clientFd, sourceCode, length)){
+                status = compileAndRun(name, sourceCode, clientFd);
+            }
+        } else {
+            std::cerr << "Malformed request: " << request << "\n";
+        }
+    }
+
+    requestErrors = nullptr;
+
+    if (!errors.empty()){
+        std::string header = "ERR " + std::to_string(errors.size()) + "\n";
+        sendAll(clientFd, header.data(), header.size());
+        sendAll(clientFd, errors.data(), errors.size());
+    }
+    std::string trailer = "EXIT " + std::to_string(status) + "\n";
+    sendAll(clientFd, trailer.data(), trailer.size());
+}
+
+int CompileServer::compileAndRun(const std::string &name, const std::string &sourceCode, int clientFd){
+    auto dylib = jit.createScriptDylib(name);
+    if (!dylib){
+        std::cerr << "Failed to create JITDylib: " << llvm::toString(dylib.takeError()) << "\n";
+        return 1;
+    }
+
+    bool succeeded;
+    {
+        Lexer lexer(sourceCode);
+        lexer.scanSourceCode();
+        Parser parser(lexer.getTokenList());
+        parser.parse();
+
+        SocketOutputSink sink(clientFd);
+        setOutputSink(&sink);
+        CodeGenContext context(jit, *dylib);
+        succeeded = context.generateCode(parser.getASTNodeList()) && context.runCode() && context.failedNodes == 0;
+        setOutputSink(nullptr);
+    }
+
+    if (auto Err = jit.removeScriptDylib(*dylib)){
+        std::cerr << "Failed to remove JITDylib: " << llvm::toString(std::move(Err)) << "\n";
+    }
+    return succeeded ? 0 : 1;
+}
+
+#else
+
+int CompileServer::run(){
+    std::cerr << "Server mode needs Unix domain sockets and is not supported on this platform\n";
+    return 1;
+}
+
+#endif
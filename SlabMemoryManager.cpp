@@ -0,0 +1,205 @@
+#include "include/SlabMemoryManager.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Process.h"
+#include <algorithm>
+
+using namespace llvm;
+using namespace llvm::orc;
+
+static unsigned slabProtection(SlabPool::SlabKind kind) {
+    switch (kind) {
+    case SlabPool::CODE:
+        return sys::Memory::MF_READ | sys::Memory::MF_EXEC;
+    case SlabPool::READ_ONLY_DATA:
+        return sys::Memory::MF_READ;
+    default:
+        return sys::Memory::MF_READ | sys::Memory::MF_WRITE;
+    }
+}
+
+SlabPool::SlabPool(size_t slabSize)
+    : slabSize(slabSize), pageSize(sys::Process::getPageSizeEstimate()) {}
+
+SlabPool::~SlabPool() {
+    for (auto &slab : slabs)
+        sys::Memory::releaseMappedMemory(slab->block);
+    for (auto &slab : freeSlabs)
+        sys::Memory::releaseMappedMemory(slab->block);
+}
+
+SlabPool::Slab *SlabPool::newSlab(SlabKind kind, size_t minSize) {
+    std::unique_ptr<Slab> slab;
+    if (minSize <= slabSize && !freeSlabs.empty()) {
+        slab = std::move(freeSlabs.back());
+        freeSlabs.pop_back();
+    } else {
+        std::error_code EC;
+        size_t size = std::max(slabSize, alignTo(minSize, pageSize));
+        sys::MemoryBlock block = sys::Memory::allocateMappedMemory(
+            size, nullptr, sys::Memory::MF_READ | sys::Memory::MF_WRITE, EC);
+        if (EC)
+            return nullptr;
+        slab = std::make_unique<Slab>();
+        slab->block = block;
+    }
+    slab->kind = kind;
+    slabs.push_back(std::move(slab));
+    return slabs.back().get();
+}
+
+SlabPool::Range SlabPool::carve(SlabKind kind, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size = alignTo(std::max<size_t>(size, 1), pageSize);
+
+    Slab *slab = current[kind];
+    if (!slab || slab->block.allocatedSize() - slab->offset < size) {
+        slab = newSlab(kind, size);
+        if (!slab)
+            return Range();
+        // Oversized requests get a dedicated slab, keep filling the shared one
+        if (size <= slabSize)
+            current[kind] = slab;
+    }
+
+    Range range;
+    range.slab = slab;
+    range.base = static_cast<uint8_t *>(slab->block.base()) + slab->offset;
+    range.size = size;
+    slab->offset += size;
+    slab->liveBytes += size;
+    slab->liveRanges++;
+    return range;
+}
+
+void SlabPool::release(const Range &range, size_t bytesUsedInRange) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Slab *slab = static_cast<Slab *>(range.slab);
+    slab->liveBytes -= range.size;
+    slab->liveRanges--;
+    bytesUsed -= bytesUsedInRange;
+    if (slab->liveRanges == 0)
+        recycle(slab);
+}
+
+void SlabPool::noteUsed(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    bytesUsed += bytes;
+}
+
+void SlabPool::recycle(Slab *slab) {
+    if (slab->kind != READ_WRITE_DATA)
+        sys::Memory::protectMappedMemory(slab->block, sys::Memory::MF_READ | sys::Memory::MF_WRITE);
+    slab->offset = 0;
+
+    for (auto &c : current)
+        if (c == slab)
+            c = nullptr;
+
+    auto it = std::find_if(slabs.begin(), slabs.end(),
+                           [slab](const std::unique_ptr<Slab> &s) { return s.get() == slab; });
+    std::unique_ptr<Slab> owned = std::move(*it);
+    slabs.erase(it);
+
+    // Keep a few empty slabs around for the next modules, give the rest back
+    if (owned->block.allocatedSize() == slabSize && freeSlabs.size() < 4)
+        freeSlabs.push_back(std::move(owned));
+    else
+        sys::Memory::releaseMappedMemory(owned->block);
+}
+
+SlabPool::Stats SlabPool::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats stats;
+    uint64_t liveBytes = 0;
+    for (auto &slab : slabs) {
+        stats.bytesReserved += slab->block.allocatedSize();
+        liveBytes += slab->liveBytes;
+        // Holes left by unloaded objects stay unusable until the whole slab is free
+        stats.bytesFragmented += slab->offset - slab->liveBytes;
+    }
+    for (auto &slab : freeSlabs)
+        stats.bytesReserved += slab->block.allocatedSize();
+    stats.bytesUsed = bytesUsed;
+    // Page rounding and alignment padding inside live ranges
+    stats.bytesFragmented += liveBytes - bytesUsed;
+    stats.slabCount = slabs.size() + freeSlabs.size();
+    stats.freeSlabCount = freeSlabs.size();
+    return stats;
+}
+
+SlabMemoryManager::~SlabMemoryManager() {
+    for (auto &kindRegions : regions)
+        for (auto &region : kindRegions)
+            pool.release(region.range, region.used);
+}
+
+void SlabMemoryManager::reserveAllocationSpace(uintptr_t CodeSize, Align CodeAlign, uintptr_t RODataSize,
+                                               Align RODataAlign, uintptr_t RWDataSize, Align RWDataAlign) {
+    // One contiguous range per kind for the whole object; allocate() falls back
+    // to another range if RuntimeDyld asks for more than it announced here.
+    auto reserve = [this](SlabPool::SlabKind kind, uintptr_t size, Align alignment) {
+        if (size == 0)
+            return;
+        Region region;
+        region.range = pool.carve(kind, size + alignment.value());
+        if (region.range.base)
+            regions[kind].push_back(region);
+    };
+    reserve(SlabPool::CODE, CodeSize, CodeAlign);
+    reserve(SlabPool::READ_ONLY_DATA, RODataSize, RODataAlign);
+    reserve(SlabPool::READ_WRITE_DATA, RWDataSize, RWDataAlign);
+}
+
+uint8_t *SlabMemoryManager::allocate(SlabPool::SlabKind kind, uintptr_t size, unsigned alignment) {
+    if (alignment == 0)
+        alignment = 16;
+
+    auto tryRegion = [&](Region &region) -> uint8_t * {
+        uintptr_t start = alignTo(reinterpret_cast<uintptr_t>(region.range.base) + region.offset, alignment);
+        uintptr_t end = reinterpret_cast<uintptr_t>(region.range.base) + region.range.size;
+        if (start + size > end)
+            return nullptr;
+        region.offset = start + size - reinterpret_cast<uintptr_t>(region.range.base);
+        region.used += size;
+        pool.noteUsed(size);
+        return reinterpret_cast<uint8_t *>(start);
+    };
+
+    if (!regions[kind].empty())
+        if (uint8_t *ptr = tryRegion(regions[kind].back()))
+            return ptr;
+
+    Region region;
+    region.range = pool.carve(kind, size + alignment);
+    if (!region.range.base)
+        return nullptr;
+    regions[kind].push_back(region);
+    return tryRegion(regions[kind].back());
+}
+
+uint8_t *SlabMemoryManager::allocateCodeSection(uintptr_t Size, unsigned Alignment, unsigned /*SectionID*/,
+                                                StringRef /*SectionName*/) {
+    return allocate(SlabPool::CODE, Size, Alignment);
+}
+
+uint8_t *SlabMemoryManager::allocateDataSection(uintptr_t Size, unsigned Alignment, unsigned /*SectionID*/,
+                                                StringRef /*SectionName*/, bool IsReadOnly) {
+    return allocate(IsReadOnly ? SlabPool::READ_ONLY_DATA : SlabPool::READ_WRITE_DATA, Size, Alignment);
+}
+
+bool SlabMemoryManager::finalizeMemory(std::string *ErrMsg) {
+    for (auto kind : {SlabPool::CODE, SlabPool::READ_ONLY_DATA}) {
+        for (auto &region : regions[kind]) {
+            sys::MemoryBlock block(region.range.base, region.range.size);
+            // Needed on targets whose instruction cache does not follow writes, e.g. AArch64
+            if (kind == SlabPool::CODE)
+                sys::Memory::InvalidateInstructionCache(region.range.base, region.range.size);
+            if (auto EC = sys::Memory::protectMappedMemory(block, slabProtection(kind))) {
+                if (ErrMsg)
+                    *ErrMsg = EC.message();
+                return true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "include/Strings.h"
+#include "include/GCBackend.h"
+#include "include/Runtime.h"
+
+static bool isInline(const char *value){
+    return reinterpret_cast<uintptr_t>(value) & 1;
+}
+
+static const char *fromWord(uint64_t word){
+    return reinterpret_cast<const char *>(word);
+}
+
+// Characters and length of a value, whether inline or not
+struct Text {
+    const char *chars;
+    size_t length;
+    char inlineChars[StringInfo::MaxInlineLength];
+
+    explicit Text(const char *value){
+        uint64_t word = reinterpret_cast<uintptr_t>(value);
+        if (word & 1){
+            length = (word >> 1) & 7;
+            for (size_t i = 0; i < length; i++){
+                inlineChars[i] = static_cast<char>(word >> (8 + 8 * i));
+            }
+            chars = inlineChars;
+        } else {
+            chars = value;
+            length = StringInfo::of(value)->length;
+        }
+    }
+    Text(const Text &) = delete;
+    Text &operator=(const Text &) = delete;
+};
+
+// A heap string with room for `capacity` bytes, none of them used yet
+static StringInfo *allocateString(size_t capacity){
+    static_assert(sizeof(StringInfo) % 16 == 0, "string characters must stay 16-byte aligned");
+    GCBackend *backend = GCBackend::current();
+    if (!backend){
+        std::cerr << "string allocated outside of a running program\n";
+        runtimeError();
+    }
+    if (capacity > SIZE_MAX / 2){
+        std::cerr << "Invalid string length " << capacity << "\n";
+        runtimeError();
+    }
+    return static_cast<StringInfo *>(backend->allocate(HeapKind::String, sizeof(StringInfo) + capacity));
+}
+
+static size_t capacityOf(StringInfo *info){
+    return HeapHeader::of(info)->size - sizeof(StringInfo);
+}
+
+// Joins two strings, into a new heap string with `capacity` bytes of room
+// unless the result is short enough to be inline
+static const char *join(const Text &a, const Text &b, size_t capacity, const void *owner){
+    size_t length = a.length + b.length;
+    if (length <= StringInfo::MaxInlineLength){
+        char chars[StringInfo::MaxInlineLength];
+        std::copy(a.chars, a.chars + a.length, chars);
+        std::copy(b.chars, b.chars + b.length, chars + a.length);
+        return fromWord(StringInfo::inlineWord(chars, length));
+    }
+    StringInfo *info = allocateString(std::max(capacity, length));
+    char *chars = reinterpret_cast<char *>(info + 1);
+    memcpy(chars, a.chars, a.length);
+    memcpy(chars + a.length, b.chars, b.length);
+    info->owner = owner;
+    info->length = length;
+    return chars;
+}
+
+extern "C" const char *dnm_str_concat(const char *lhs, const char *rhs){
+    Text a(lhs), b(rhs);
+    // The result is the other string itself, which from now on is in two places
+    if (a.length == 0){
+        dnm_str_share(rhs);
+        return rhs;
+    }
+    if (b.length == 0){
+        dnm_str_share(lhs);
+        return lhs;
+    }
+    return join(a, b, 0, nullptr);
+}
+
+extern "C" void dnm_str_append(const char **slot, const char *rhs){
+    Text b(rhs);
+    if (b.length == 0){
+        return;
+    }
+    const char *current = *slot;
+    if (!isInline(current)){
+        StringInfo *info = StringInfo::of(current);
+        if (info->owner == slot && capacityOf(info) - info->length >= b.length){
+            // rhs may be this very string; its first bytes stay where they are
+            memcpy(const_cast<char *>(current) + info->length, b.chars, b.length);
+            info->length += b.length;
+            return;
+        }
+    }
+    Text a(current);
+    *slot = join(a, b, 2 * (a.length + b.length), slot);
+}
+
+extern "C" int32_t dnm_str_compare(const char *lhs, const char *rhs){
+    Text a(lhs), b(rhs);
+    int order = memcmp(a.chars, b.chars, std::min(a.length, b.length));
+    if (order == 0 && a.length != b.length){
+        order = a.length < b.length ? -1 : 1;
+    }
+    return (order > 0) - (order < 0);
+}
+
+extern "C" void dnm_str_share(const char *value){
+    if (!isInline(value)){
+        StringInfo *info = StringInfo::of(value);
+        // Literals, which are read-only, never have an owner
+        if (info->owner){
+            info->owner = nullptr;
+        }
+    }
+}
+
+extern "C" void dnm_print_str(const char *value){
+    Text text(value);
+    appendOutput(text.chars, text.length);
+    appendOutput("\n", 1);
+}
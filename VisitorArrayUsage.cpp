@@ -0,0 +1,231 @@
+#include "include/VisitorArrayUsage.h"
+
+using namespace std;
+
+set<string> VisitorArrayUsage::aliasesOf(const string &name) const
+{
+    set<string> aliases = {name};
+    vector<string> pending = {name};
+    while (!pending.empty())
+    {
+        string current = pending.back();
+        pending.pop_back();
+        auto targets = boundTo.find(current);
+        if (targets == boundTo.end())
+        {
+            continue;
+        }
+        for (auto &target : targets->second)
+        {
+            if (aliases.insert(target).second)
+            {
+                pending.push_back(target);
+            }
+        }
+    }
+    return aliases;
+}
+
+bool VisitorArrayUsage::usedAs(const set<string> &names, const string &name) const
+{
+    for (auto &alias : aliasesOf(name))
+    {
+        if (names.count(alias))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void VisitorArrayUsage::visitExpression(Expression &)
+{
+}
+
+void VisitorArrayUsage::visitStatement(Statement &)
+{
+}
+
+void VisitorArrayUsage::visitIntegerLiteral(IntegerLiteral &)
+{
+}
+
+void VisitorArrayUsage::visitFloatLiteral(FloatLiteral &)
+{
+}
+
+void VisitorArrayUsage::visitStringLiteral(StringLiteral &)
+{
+}
+
+void VisitorArrayUsage::visitCharLiteral(CharLiteral &)
+{
+}
+
+void VisitorArrayUsage::visitBoolLiteral(BoolLiteral &)
+{
+}
+
+void VisitorArrayUsage::visitIdentifier(Identifier &)
+{
+}
+
+void VisitorArrayUsage::visitUnary(Unary &node)
+{
+    node.operand->accept(*this);
+}
+
+void VisitorArrayUsage::visitBinary(Binary &node)
+{
+    node.leftOperand->accept(*this);
+    node.rightOperand->accept(*this);
+}
+
+void VisitorArrayUsage::visitComparison(Comparison &node)
+{
+    node.leftOperand->accept(*this);
+    node.rightOperand->accept(*this);
+}
+
+void VisitorArrayUsage::visitCallFunction(CallFunction &node)
+{
+    hasCall = true;
+    for (auto &arg : node.functionArgs)
+    {
+        if (auto identifier = dynamic_cast<Identifier *>(arg.get()))
+        {
+            passed.insert(identifier->value);
+        }
+        arg->accept(*this);
+    }
+}
+
+void VisitorArrayUsage::visitArrayAccess(ArrayAccess &node)
+{
+    read.insert(node.identifier->value);
+    node.index->accept(*this);
+}
+
+void VisitorArrayUsage::visitAssignment(Assignment &node)
+{
+    if (auto access = dynamic_cast<ArrayAccess *>(node.identifier.get()))
+    {
+        written.insert(access->identifier->value);
+        access->index->accept(*this);
+    }
+    node.value->accept(*this);
+}
+
+void VisitorArrayUsage::visitExpressionStatement(ExpressionStatement &node)
+{
+    node.expression->accept(*this);
+}
+
+void VisitorArrayUsage::visitArrayDeclaration(ArrayDeclaration &node)
+{
+    if (node.source != nullptr)
+    {
+        bound.insert(node.identifier->value);
+        if (auto source = dynamic_cast<Identifier *>(node.source.get()))
+        {
+            boundTo[source->value].insert(node.identifier->value);
+        }
+        node.source->accept(*this);
+        return;
+    }
+    declared.insert(node.identifier->value);
+    node.size->accept(*this);
+    for (auto &initValue : node.initValues)
+    {
+        if (initValue != nullptr)
+        {
+            initValue->accept(*this);
+        }
+    }
+}
+
+void VisitorArrayUsage::visitVariableDeclaration(VariableDeclaration &node)
+{
+    if (node.initValue != nullptr)
+    {
+        node.initValue->accept(*this);
+    }
+}
+
+void VisitorArrayUsage::visitPrint(Print &node)
+{
+    node.expr->accept(*this);
+}
+
+void VisitorArrayUsage::visitBlock(Block &node)
+{
+    for (auto &stmt : node.statementList)
+    {
+        if (stmt)
+        {
+            stmt->accept(*this);
+        }
+    }
+}
+
+void VisitorArrayUsage::visitCondition(Condition &node)
+{
+    node.conditionExpr->accept(*this);
+    node.ifBlock->accept(*this);
+    if (node.elseBlock != nullptr)
+    {
+        node.elseBlock->accept(*this);
+    }
+}
+
+void VisitorArrayUsage::visitForLoop(ForLoop &node)
+{
+    if (node.initializer != nullptr)
+    {
+        node.initializer->accept(*this);
+    }
+    if (node.condition != nullptr)
+    {
+        node.condition->accept(*this);
+    }
+    if (node.update != nullptr)
+    {
+        node.update->accept(*this);
+    }
+    if (node.body != nullptr)
+    {
+        node.body->accept(*this);
+    }
+}
+
+void VisitorArrayUsage::visitWhileLoop(WhileLoop &node)
+{
+    node.condition->accept(*this);
+    node.body->accept(*this);
+}
+
+void VisitorArrayUsage::visitPrototypeFunction(PrototypeFunction &)
+{
+}
+
+void VisitorArrayUsage::visitFunction(FunctionNode &node)
+{
+    node.bodyBlock->accept(*this);
+}
+
+void VisitorArrayUsage::visitReturn(Return &node)
+{
+    if (node.expr == nullptr)
+    {
+        return;
+    }
+    if (auto identifier = dynamic_cast<Identifier *>(node.expr.get()))
+    {
+        returned.insert(identifier->value);
+    }
+    else
+    {
+        returnsExpression = true;
+    }
+    node.expr->accept(*this);
+}
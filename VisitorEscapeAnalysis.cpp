@@ -0,0 +1,258 @@
+#include "include/VisitorEscapeAnalysis.h"
+
+using namespace std;
+
+void VisitorEscapeAnalysis::run(vector<unique_ptr<ASTNode>> &nodeList)
+{
+    vector<FunctionNode *> functions;
+    for (auto &node : nodeList)
+    {
+        if (auto function = dynamic_cast<FunctionNode *>(node.get()))
+        {
+            functions.push_back(function);
+            // Nothing returned until a body says otherwise; iterating from
+            // there gives the smallest summaries recursion allows
+            summaries[function->prototype->name] = vector<bool>(function->prototype->args.size(), false);
+        }
+    }
+
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (FunctionNode *function : functions)
+        {
+            startBody();
+            function->accept(*this);
+            set<string> escaping = escapingNames();
+            PrototypeFunction &prototype = *function->prototype;
+            vector<bool> summary(prototype.args.size());
+            for (size_t i = 0; i < prototype.args.size(); i++)
+            {
+                summary[i] = prototype.arrayArgs[i] && escaping.count(prototype.args[i].second);
+            }
+            if (summary != summaries[prototype.name])
+            {
+                summaries[prototype.name] = summary;
+                changed = true;
+            }
+        }
+    }
+
+    for (FunctionNode *function : functions)
+    {
+        startBody();
+        function->accept(*this);
+        set<string> escaping = escapingNames();
+        for (ArrayDeclaration *declaration : declarations)
+        {
+            declaration->escapes = escaping.count(declaration->identifier->value);
+        }
+    }
+
+    startBody();
+    for (auto &node : nodeList)
+    {
+        if (!dynamic_cast<FunctionNode *>(node.get()))
+        {
+            node->accept(*this);
+        }
+    }
+    set<string> escaping = escapingNames();
+    for (ArrayDeclaration *declaration : declarations)
+    {
+        declaration->escapes = escaping.count(declaration->identifier->value);
+    }
+}
+
+set<string> VisitorEscapeAnalysis::sourcesOf(Expression *expr) const
+{
+    set<string> sources;
+    if (auto identifier = dynamic_cast<Identifier *>(expr))
+    {
+        sources.insert(identifier->value);
+    }
+    else if (auto call = dynamic_cast<CallFunction *>(expr))
+    {
+        // A function of a later unit, or none at all, may return any argument
+        auto summary = summaries.find(call->functionName);
+        for (size_t i = 0; i < call->functionArgs.size(); i++)
+        {
+            if (summary == summaries.end() || i >= summary->second.size() || summary->second[i])
+            {
+                set<string> argumentSources = sourcesOf(call->functionArgs[i].get());
+                sources.insert(argumentSources.begin(), argumentSources.end());
+            }
+        }
+    }
+    return sources;
+}
+
+void VisitorEscapeAnalysis::startBody()
+{
+    boundTo.clear();
+    returned.clear();
+    declarations.clear();
+}
+
+set<string> VisitorEscapeAnalysis::escapingNames() const
+{
+    set<string> escaping = returned;
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (auto &[name, targets] : boundTo)
+        {
+            if (escaping.count(name))
+                continue;
+            for (auto &target : targets)
+            {
+                if (escaping.count(target))
+                {
+                    escaping.insert(name);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+    return escaping;
+}
+
+void VisitorEscapeAnalysis::visitExpression(Expression &)
+{
+}
+
+void VisitorEscapeAnalysis::visitStatement(Statement &)
+{
+}
+
+void VisitorEscapeAnalysis::visitIntegerLiteral(IntegerLiteral &)
+{
+}
+
+void VisitorEscapeAnalysis::visitFloatLiteral(FloatLiteral &)
+{
+}
+
+void VisitorEscapeAnalysis::visitStringLiteral(StringLiteral &)
+{
+}
+
+void VisitorEscapeAnalysis::visitCharLiteral(CharLiteral &)
+{
+}
+
+void VisitorEscapeAnalysis::visitBoolLiteral(BoolLiteral &)
+{
+}
+
+void VisitorEscapeAnalysis::visitIdentifier(Identifier &)
+{
+}
+
+// Expressions never keep an array: a call's result is only kept by the
+// declaration or return it appears in, which look at it through sourcesOf
+void VisitorEscapeAnalysis::visitUnary(Unary &)
+{
+}
+
+void VisitorEscapeAnalysis::visitBinary(Binary &)
+{
+}
+
+void VisitorEscapeAnalysis::visitComparison(Comparison &)
+{
+}
+
+void VisitorEscapeAnalysis::visitCallFunction(CallFunction &)
+{
+}
+
+void VisitorEscapeAnalysis::visitArrayAccess(ArrayAccess &)
+{
+}
+
+void VisitorEscapeAnalysis::visitAssignment(Assignment &)
+{
+}
+
+void VisitorEscapeAnalysis::visitExpressionStatement(ExpressionStatement &)
+{
+}
+
+void VisitorEscapeAnalysis::visitArrayDeclaration(ArrayDeclaration &node)
+{
+    if (node.source == nullptr)
+    {
+        declarations.push_back(&node);
+        return;
+    }
+    for (auto &source : sourcesOf(node.source.get()))
+    {
+        boundTo[source].insert(node.identifier->value);
+    }
+}
+
+void VisitorEscapeAnalysis::visitVariableDeclaration(VariableDeclaration &)
+{
+}
+
+void VisitorEscapeAnalysis::visitPrint(Print &)
+{
+}
+
+void VisitorEscapeAnalysis::visitBlock(Block &node)
+{
+    for (auto &stmt : node.statementList)
+    {
+        if (stmt)
+        {
+            stmt->accept(*this);
+        }
+    }
+}
+
+void VisitorEscapeAnalysis::visitCondition(Condition &node)
+{
+    node.ifBlock->accept(*this);
+    if (node.elseBlock != nullptr)
+    {
+        node.elseBlock->accept(*this);
+    }
+}
+
+void VisitorEscapeAnalysis::visitForLoop(ForLoop &node)
+{
+    if (node.initializer != nullptr)
+    {
+        node.initializer->accept(*this);
+    }
+    if (node.body != nullptr)
+    {
+        node.body->accept(*this);
+    }
+}
+
+void VisitorEscapeAnalysis::visitWhileLoop(WhileLoop &node)
+{
+    node.body->accept(*this);
+}
+
+void VisitorEscapeAnalysis::visitPrototypeFunction(PrototypeFunction &)
+{
+}
+
+void VisitorEscapeAnalysis::visitFunction(FunctionNode &node)
+{
+    node.bodyBlock->accept(*this);
+}
+
+void VisitorEscapeAnalysis::visitReturn(Return &node)
+{
+    if (node.expr == nullptr)
+    {
+        return;
+    }
+    set<string> sources = sourcesOf(node.expr.get());
+    returned.insert(sources.begin(), sources.end());
+}
@@ -110,8 +110,16 @@ void VisitorPrintNode::visitArrayDeclaration(ArrayDeclaration &node)
     node.isChecked = true;
     out << "Create " << node.toString() << endl;
     node.identifier->accept(*this);
+    if (node.size != nullptr){
+        node.size->accept(*this);
+    }
     for (auto &initValue : node.initValues){
-        initValue->accept(*this);
+        if (initValue != nullptr){
+            initValue->accept(*this);
+        }
+    }
+    if (node.source != nullptr){
+        node.source->accept(*this);
     }
 }
 
@@ -181,8 +189,8 @@ void VisitorPrintNode::visitPrototypeFunction(PrototypeFunction &node)
     node.isChecked = true;
     out << "Create " << node.toString() << endl;
     out << "Args: " << endl;
-    for (auto arg : node.args){
-        out << arg.first << " " << arg.second << endl;
+    for (size_t i = 0; i < node.args.size(); i++){
+        out << (node.arrayArgs[i] ? "array " : "") << node.args[i].first << " " << node.args[i].second << endl;
     }
 }
 
@@ -0,0 +1,533 @@
+#include <algorithm>
+#include <cmath>
+#include "include/VisitorRangeAnalysis.h"
+
+using namespace std;
+
+static bool fitsInt(int64_t low, int64_t high)
+{
+    return low >= INT32_MIN && high <= INT32_MAX;
+}
+
+static Identifier *asIdentifier(Expression *expr)
+{
+    return dynamic_cast<Identifier *>(expr);
+}
+
+static bool isIdentifier(Expression *expr, const string &name)
+{
+    Identifier *identifier = asIdentifier(expr);
+    return identifier && identifier->value == name;
+}
+
+void VisitorRangeAnalysis::run(vector<unique_ptr<ASTNode>> &nodeList)
+{
+    for (auto &node : nodeList)
+    {
+        set<string> names = assignedNames(*node);
+        assigned.insert(names.begin(), names.end());
+    }
+    for (auto &node : nodeList)
+    {
+        node->accept(*this);
+    }
+}
+
+set<string> VisitorRangeAnalysis::assignedNames(ASTNode &node, bool *hasCall)
+{
+    VisitorRangeAnalysis collector(false);
+    collector.collectOnly = true;
+    node.accept(collector);
+    if (hasCall)
+    {
+        *hasCall = collector.sawCall;
+    }
+    return collector.assigned;
+}
+
+const VisitorRangeAnalysis::Variable *VisitorRangeAnalysis::lookup(const string &name, size_t *depth) const
+{
+    for (size_t i = scopes.size(); i-- > 0;)
+    {
+        auto it = scopes[i].find(name);
+        if (it != scopes[i].end())
+        {
+            if (depth)
+            {
+                *depth = i;
+            }
+            return &it->second;
+        }
+    }
+    return nullptr;
+}
+
+void VisitorRangeAnalysis::declare(const string &name, const Variable &variable)
+{
+    if (!collectOnly)
+    {
+        scopes.back()[name] = variable;
+    }
+}
+
+bool VisitorRangeAnalysis::rangeOf(Expression *expr, ValueRange &range) const
+{
+    if (auto literal = dynamic_cast<IntegerLiteral *>(expr))
+    {
+        range = {literal->value, literal->value};
+        return true;
+    }
+    if (auto identifier = asIdentifier(expr))
+    {
+        const Variable *variable = lookup(identifier->value);
+        if (!variable || !variable->hasRange)
+            return false;
+        range = variable->range;
+        return true;
+    }
+    if (auto unary = dynamic_cast<Unary *>(expr))
+    {
+        ValueRange operand;
+        if (unary->_operator.type != MINUS || !rangeOf(unary->operand.get(), operand))
+            return false;
+        range = {-operand.high, -operand.low};
+        return fitsInt(range.low, range.high);
+    }
+    auto binary = dynamic_cast<Binary *>(expr);
+    ValueRange left, right;
+    if (!binary || !rangeOf(binary->leftOperand.get(), left) || !rangeOf(binary->rightOperand.get(), right))
+        return false;
+
+    // int arithmetic wraps at 32 bits, so a result range is only usable when
+    // it stays inside int
+    switch (binary->_operator.type)
+    {
+    case PLUS:
+        range = {left.low + right.low, left.high + right.high};
+        break;
+    case MINUS:
+        range = {left.low - right.high, left.high - right.low};
+        break;
+    case MULTIPLY:
+    {
+        int64_t products[] = {left.low * right.low, left.low * right.high, left.high * right.low, left.high * right.high};
+        range = {*min_element(begin(products), end(products)), *max_element(begin(products), end(products))};
+        break;
+    }
+    case MODULO:
+        // srem keeps the sign of the dividend
+        if (right.low <= 0 || right.low != right.high)
+            return false;
+        range = {left.low < 0 ? -(right.low - 1) : 0, left.high > 0 ? right.low - 1 : 0};
+        break;
+    default:
+        return false;
+    }
+    return fitsInt(range.low, range.high);
+}
+
+// Whether the expression has the same value on every iteration of a loop whose
+// body assigns bodyAssigned. Functions the body calls may assign globals.
+bool VisitorRangeAnalysis::isInvariant(Expression *expr, const set<string> &bodyAssigned, bool bodyHasCall) const
+{
+    if (dynamic_cast<IntegerLiteral *>(expr))
+        return true;
+    if (auto identifier = asIdentifier(expr))
+    {
+        const Variable *variable = lookup(identifier->value);
+        if (bodyAssigned.count(identifier->value))
+            return false;
+        return !bodyHasCall || (variable && !variable->isGlobal);
+    }
+    if (auto unary = dynamic_cast<Unary *>(expr))
+        return unary->_operator.type == MINUS && isInvariant(unary->operand.get(), bodyAssigned, bodyHasCall);
+    if (auto binary = dynamic_cast<Binary *>(expr))
+    {
+        TokenType op = binary->_operator.type;
+        return (op == PLUS || op == MINUS || op == MULTIPLY) &&
+               isInvariant(binary->leftOperand.get(), bodyAssigned, bodyHasCall) &&
+               isInvariant(binary->rightOperand.get(), bodyAssigned, bodyHasCall);
+    }
+    return false;
+}
+
+// Recognizes `for (int v = start; v < limit; v = v + step)` with a positive
+// step, also with <=, with `v * v` compared against the limit, and counting
+// down with > or >= and v = v - step. The range holds for v inside the body.
+bool VisitorRangeAnalysis::countedLoopRange(ForLoop &node, string &variable, ValueRange &range, bool &hoistable)
+{
+    hoistable = false;
+    auto declaration = dynamic_cast<VariableDeclaration *>(node.initializer.get());
+    auto comparison = dynamic_cast<Comparison *>(node.condition.get());
+    auto update = dynamic_cast<Assignment *>(node.update.get());
+    if (!declaration || declaration->type != INT || !declaration->initValue || !comparison || !update || !node.body)
+        return false;
+    variable = declaration->identifier->value;
+
+    auto next = dynamic_cast<Binary *>(update->value.get());
+    if (!isIdentifier(update->identifier.get(), variable) || !next)
+        return false;
+    TokenType direction = next->_operator.type;
+    Expression *step;
+    if (isIdentifier(next->leftOperand.get(), variable))
+        step = next->rightOperand.get();
+    else if (direction == PLUS && isIdentifier(next->rightOperand.get(), variable))
+        step = next->leftOperand.get();
+    else
+        return false;
+
+    bool squared = false;
+    if (!isIdentifier(comparison->leftOperand.get(), variable))
+    {
+        auto product = dynamic_cast<Binary *>(comparison->leftOperand.get());
+        squared = product && product->_operator.type == MULTIPLY &&
+                  isIdentifier(product->leftOperand.get(), variable) && isIdentifier(product->rightOperand.get(), variable);
+        if (!squared)
+            return false;
+    }
+
+    bool hasCall;
+    set<string> bodyAssigned = assignedNames(*node.body, &hasCall);
+    ValueRange start, limit, stepRange;
+    if (bodyAssigned.count(variable) || !rangeOf(step, stepRange) || stepRange.low < 1)
+        return false;
+
+    TokenType op = comparison->_operator.type;
+    Expression *limitExpr = comparison->rightOperand.get();
+    if (direction == PLUS && !squared && (op == LESS || op == LESS_EQUAL) && stepRange.high == 1)
+    {
+        // Checks can be done against the limit's value before the loop as long
+        // as it does not change while the loop runs
+        set<string> changing = bodyAssigned;
+        changing.insert(variable);
+        hoistable = isInvariant(limitExpr, changing, hasCall);
+    }
+    if (!rangeOf(declaration->initValue.get(), start) || !rangeOf(limitExpr, limit))
+        return false;
+
+    if (direction == PLUS && (op == LESS || op == LESS_EQUAL))
+    {
+        int64_t bound = op == LESS ? limit.high - 1 : limit.high;
+        int64_t last = bound;
+        if (squared)
+        {
+            if (start.low < 0)
+                return false;
+            last = bound < 0 ? -1 : static_cast<int64_t>(sqrt(static_cast<double>(bound)));
+            while ((last + 1) * (last + 1) <= bound)
+                last++;
+            while (last > 0 && last * last > bound)
+                last--;
+            // v * v must not wrap when v steps past the last value
+            if ((last + stepRange.high) * (last + stepRange.high) > INT32_MAX)
+                return false;
+        }
+        else if (last + stepRange.high > INT32_MAX)
+        {
+            return false;
+        }
+        range = {start.low, last};
+        return true;
+    }
+    if (direction == MINUS && !squared && (op == GREATER || op == GREATER_EQUAL))
+    {
+        int64_t last = op == GREATER ? limit.low + 1 : limit.low;
+        if (last - stepRange.high < INT32_MIN)
+            return false;
+        range = {last, start.high};
+        return true;
+    }
+    return false;
+}
+
+void VisitorRangeAnalysis::checkAccess(ArrayAccess &node)
+{
+    size_t depth = 0;
+    const Variable *array = lookup(node.identifier->value, &depth);
+    ValueRange index;
+    if (array && array->arrayLength >= 0 && rangeOf(node.index.get(), index) &&
+        index.low >= 0 && index.high < array->arrayLength)
+    {
+        node.inBounds = true;
+        return;
+    }
+
+    // Hoisting needs the array to exist before the loop starts
+    if (loops.empty() || loops.back().variable.empty() || (array && depth >= loops.back().scopeDepth))
+        return;
+    const string &variable = loops.back().variable;
+    ValueRange offset = {0, 0};
+    Expression *indexExpr = node.index.get();
+    auto binary = dynamic_cast<Binary *>(indexExpr);
+    if (binary && binary->_operator.type == PLUS && isIdentifier(binary->rightOperand.get(), variable))
+    {
+        indexExpr = binary->rightOperand.get();
+        if (!rangeOf(binary->leftOperand.get(), offset))
+            return;
+    }
+    else if (binary && (binary->_operator.type == PLUS || binary->_operator.type == MINUS) &&
+             isIdentifier(binary->leftOperand.get(), variable))
+    {
+        indexExpr = binary->leftOperand.get();
+        if (!rangeOf(binary->rightOperand.get(), offset))
+            return;
+        if (binary->_operator.type == MINUS)
+            offset = {-offset.high, -offset.low};
+    }
+    if (!isIdentifier(indexExpr, variable) || offset.low != offset.high)
+        return;
+    loops.back().node->hoistedChecks.push_back({&node, offset.low});
+}
+
+void VisitorRangeAnalysis::visitExpression(Expression &)
+{
+}
+
+void VisitorRangeAnalysis::visitStatement(Statement &)
+{
+}
+
+void VisitorRangeAnalysis::visitIntegerLiteral(IntegerLiteral &)
+{
+}
+
+void VisitorRangeAnalysis::visitFloatLiteral(FloatLiteral &)
+{
+}
+
+void VisitorRangeAnalysis::visitStringLiteral(StringLiteral &)
+{
+}
+
+void VisitorRangeAnalysis::visitCharLiteral(CharLiteral &)
+{
+}
+
+void VisitorRangeAnalysis::visitBoolLiteral(BoolLiteral &)
+{
+}
+
+void VisitorRangeAnalysis::visitIdentifier(Identifier &)
+{
+}
+
+void VisitorRangeAnalysis::visitUnary(Unary &node)
+{
+    node.operand->accept(*this);
+}
+
+void VisitorRangeAnalysis::visitBinary(Binary &node)
+{
+    node.leftOperand->accept(*this);
+    node.rightOperand->accept(*this);
+}
+
+void VisitorRangeAnalysis::visitComparison(Comparison &node)
+{
+    node.leftOperand->accept(*this);
+    node.rightOperand->accept(*this);
+}
+
+void VisitorRangeAnalysis::visitCallFunction(CallFunction &node)
+{
+    sawCall = true;
+    for (auto &arg : node.functionArgs)
+    {
+        arg->accept(*this);
+    }
+}
+
+void VisitorRangeAnalysis::visitArrayAccess(ArrayAccess &node)
+{
+    node.index->accept(*this);
+    if (!collectOnly)
+    {
+        checkAccess(node);
+    }
+}
+
+void VisitorRangeAnalysis::visitAssignment(Assignment &node)
+{
+    if (auto identifier = asIdentifier(node.identifier.get()))
+    {
+        assigned.insert(identifier->value);
+    }
+    else
+    {
+        node.identifier->accept(*this);
+    }
+    node.value->accept(*this);
+}
+
+void VisitorRangeAnalysis::visitExpressionStatement(ExpressionStatement &node)
+{
+    node.expression->accept(*this);
+}
+
+void VisitorRangeAnalysis::visitArrayDeclaration(ArrayDeclaration &node)
+{
+    if (node.size != nullptr)
+    {
+        node.size->accept(*this);
+    }
+    for (auto &initValue : node.initValues)
+    {
+        if (initValue != nullptr)
+        {
+            initValue->accept(*this);
+        }
+    }
+    if (node.source != nullptr)
+    {
+        node.source->accept(*this);
+    }
+    Variable array;
+    ValueRange length;
+    if (node.size != nullptr && rangeOf(node.size.get(), length) && length.low >= 0)
+    {
+        array.arrayLength = length.low;
+    }
+    declare(node.identifier->value, array);
+}
+
+void VisitorRangeAnalysis::visitVariableDeclaration(VariableDeclaration &node)
+{
+    if (node.initValue != nullptr)
+    {
+        node.initValue->accept(*this);
+    }
+    // Globals can be assigned by functions of other units
+    Variable variable;
+    variable.isGlobal = globalTopLevel && functionDepth == 0 && scopes.size() == 1;
+    if (node.type == INT && node.initValue && !variable.isGlobal && !assigned.count(node.identifier->value))
+    {
+        variable.hasRange = rangeOf(node.initValue.get(), variable.range);
+    }
+    declare(node.identifier->value, variable);
+}
+
+void VisitorRangeAnalysis::visitPrint(Print &node)
+{
+    node.expr->accept(*this);
+}
+
+void VisitorRangeAnalysis::visitBlock(Block &node)
+{
+    scopes.emplace_back();
+    for (auto &stmt : node.statementList)
+    {
+        if (stmt)
+        {
+            stmt->accept(*this);
+        }
+    }
+    scopes.pop_back();
+}
+
+void VisitorRangeAnalysis::visitCondition(Condition &node)
+{
+    node.conditionExpr->accept(*this);
+    node.ifBlock->accept(*this);
+    if (node.elseBlock != nullptr)
+    {
+        node.elseBlock->accept(*this);
+    }
+}
+
+void VisitorRangeAnalysis::visitForLoop(ForLoop &node)
+{
+    if (!loops.empty())
+    {
+        loops.back().hasNestedLoop = true;
+    }
+    scopes.emplace_back();
+    if (node.initializer != nullptr)
+    {
+        node.initializer->accept(*this);
+    }
+    if (node.condition != nullptr)
+    {
+        node.condition->accept(*this);
+    }
+    if (node.update != nullptr)
+    {
+        node.update->accept(*this);
+    }
+
+    Loop loop = {&node, "", scopes.size()};
+    string variable;
+    ValueRange range;
+    bool hoistable = false;
+    scopes.emplace_back();
+    if (!collectOnly)
+    {
+        node.hoistedChecks.clear();
+        if (countedLoopRange(node, variable, range, hoistable))
+        {
+            Variable counter;
+            counter.hasRange = true;
+            counter.range = range;
+            declare(variable, counter);
+        }
+        if (hoistable)
+        {
+            loop.variable = variable;
+        }
+    }
+    loops.push_back(loop);
+    if (node.body != nullptr)
+    {
+        node.body->accept(*this);
+    }
+    // Versioning a loop duplicates its body, so only innermost loops qualify
+    if (loops.back().hasNestedLoop)
+    {
+        node.hoistedChecks.clear();
+    }
+    loops.pop_back();
+    scopes.pop_back();
+    scopes.pop_back();
+}
+
+void VisitorRangeAnalysis::visitWhileLoop(WhileLoop &node)
+{
+    if (!loops.empty())
+    {
+        loops.back().hasNestedLoop = true;
+    }
+    node.condition->accept(*this);
+    loops.push_back({nullptr, "", scopes.size()});
+    node.body->accept(*this);
+    loops.pop_back();
+}
+
+void VisitorRangeAnalysis::visitPrototypeFunction(PrototypeFunction &node)
+{
+    for (auto &arg : node.args)
+    {
+        declare(arg.second, Variable());
+    }
+}
+
+void VisitorRangeAnalysis::visitFunction(FunctionNode &node)
+{
+    // A function body sees none of the facts of the code around it
+    vector<map<string, Variable>> outerScopes(1);
+    vector<Loop> outerLoops;
+    swap(scopes, outerScopes);
+    swap(loops, outerLoops);
+    functionDepth++;
+    node.prototype->accept(*this);
+    node.bodyBlock->accept(*this);
+    functionDepth--;
+    swap(scopes, outerScopes);
+    swap(loops, outerLoops);
+}
+
+void VisitorRangeAnalysis::visitReturn(Return &node)
+{
+    if (node.expr != nullptr)
+    {
+        node.expr->accept(*this);
+    }
+}
@@ -1,7 +1,6 @@
 #pragma once
 
 #include "Token.hpp"
-#include "GCManager.h"
 #include <vector>
 #include <sstream>
 #include <memory>
@@ -14,7 +13,7 @@
 class Visitor;
 class CodeGenContext;
 
-class ASTNode : public GCObject {
+class ASTNode {
 public:
     virtual ~ASTNode() = default;
     virtual void accept(Visitor& visitor) = 0;
@@ -22,7 +21,6 @@ public:
     bool isChecked = false;
 
     virtual llvm::Value* codeGeneration(CodeGenContext& context) = 0;
-    void traceReferences(std::function<void(GCObject*)> visitor) override {}
 };
 
 class Expression : public ASTNode {
@@ -144,10 +142,6 @@ public:
         return s.str();
     }
     llvm::Value* codeGeneration(CodeGenContext& context) override;
-
-    void traceReferences(std::function<void(GCObject*)> visitor) override {
-        if (operand) visitor(operand.get());
-    }
 };
 
 class Binary : public Expression {
@@ -164,11 +158,6 @@ public:
         return s.str();
     }
     llvm::Value* codeGeneration(CodeGenContext& context) override;
-
-    void traceReferences(std::function<void(GCObject*)> visitor) override {
-        if (leftOperand) visitor(leftOperand.get());
-        if (rightOperand) visitor(rightOperand.get());
-    }
 };
 
 class Comparison : public Expression {
@@ -200,19 +189,18 @@ public:
         s << "Call FunctionNode with name: " << functionName;
         return s.str();
     }
+    // Refuses calls returning an array, which are only arrays where one is expected
     llvm::Value* codeGeneration(CodeGenContext& context) override;
-
-    void traceReferences(std::function<void(GCObject*)> visitor) override {
-        for (auto& arg : functionArgs) {
-            if (arg) visitor(arg.get());
-        }
-    }
+    // Emits the call whatever the function returns
+    llvm::Value* createCall(CodeGenContext& context);
 };
 
 class ArrayAccess : public Expression {
 public:
     std::unique_ptr<Identifier> identifier;
     std::unique_ptr<Expression> index;
+    // Proven in bounds by VisitorRangeAnalysis, so --bounds-check skips it
+    bool inBounds = false;
 
     ArrayAccess(std::unique_ptr<Identifier> identifier, std::unique_ptr<Expression> index):
         identifier(std::move(identifier)), index(std::move(index)){};
@@ -224,10 +212,6 @@ public:
         return s.str();
     }
     llvm::Value* codeGeneration(CodeGenContext& context) override;
-
-    void traceReferences(std::function<void(GCObject*)> visitor) override {
-        if (identifier) visitor(identifier.get());
-    }
 };
 
 class Assignment : public Expression {
@@ -244,11 +228,6 @@ public:
         return s.str();
     }
     llvm::Value* codeGeneration(CodeGenContext& context) override;
-
-    void traceReferences(std::function<void(GCObject*)> visitor) override {
-        if (identifier) visitor(identifier.get());
-        if (value) visitor(value.get());
-    }
 };
 
 // --------------------------Statement-------------------------
@@ -266,27 +245,38 @@ public:
         return s.str();
     }
     llvm::Value* codeGeneration(CodeGenContext& context) override;
-
-    void traceReferences(std::function<void(GCObject*)> visitor) override {
-        if (expression) visitor(expression.get());
-    }
 };
 
 class ArrayDeclaration : public Statement {
 public:
     TokenType type;
     std::unique_ptr<Identifier> identifier;
-    int size;
+    std::unique_ptr<Expression> size;
+    // Entries that are literals are null here and packed into constantInit,
+    // which holds every entry in the element layout (zero for the others)
     std::vector<std::unique_ptr<Expression>> initValues;
+    std::vector<uint8_t> constantInit;
+    // Set instead of a size for `array int a = f(...);`, which names the array
+    // a function returned rather than creating one
+    std::unique_ptr<Expression> source;
+    // Cleared by VisitorEscapeAnalysis when the array cannot outlive the
+    // function declaring it
+    bool escapes = true;
 
     ArrayDeclaration(TokenType type, 
                     std::unique_ptr<Identifier> identifier,
-                    int size,
-                    std::vector<std::unique_ptr<Expression>> initValues) :
+                    std::unique_ptr<Expression> size,
+                    std::vector<std::unique_ptr<Expression>> initValues,
+                    std::vector<uint8_t> constantInit = {}) :
+                    type(type),
+                    identifier(std::move(identifier)),
+                    size(std::move(size)),
+                    initValues(std::move(initValues)),
+                    constantInit(std::move(constantInit)){};
+    ArrayDeclaration(TokenType type, std::unique_ptr<Identifier> identifier, std::unique_ptr<Expression> source) :
                     type(type),
                     identifier(std::move(identifier)),
-                    size(size),
-                    initValues(std::move(initValues)){};
+                    source(std::move(source)){};
     void accept(Visitor& visitor) override;
     std::string toString() override {
         std::stringstream s;
@@ -294,13 +284,6 @@ public:
         return s.str();
     }
     llvm::Value* codeGeneration(CodeGenContext& context) override;
-
-    void traceReferences(std::function<void(GCObject*)> visitor) override {
-        if (identifier) visitor(identifier.get());
-        for (auto& initValue : initValues) {
-            if (initValue) visitor(initValue.get());
-        }
-    }
 };
 
 class VariableDeclaration : public Statement {
@@ -318,11 +301,6 @@ public:
         return s.str();
     }
     llvm::Value* codeGeneration(CodeGenContext& context) override;
-
-    void traceReferences(std::function<void(GCObject*)> visitor) override {
-        if (identifier) visitor(identifier.get());
-        if (initValue) visitor(initValue.get());
-    }
 };
 
 class Print : public Statement {
@@ -337,10 +315,6 @@ public:
         return s.str();
     }
     llvm::Value* codeGeneration(CodeGenContext& context) override;
-
-    void traceReferences(std::function<void(GCObject*)> visitor) override {
-        if (expr) visitor(expr.get());
-    }
 };
 
 class Block : public Statement {
@@ -356,12 +330,6 @@ public:
         return s.str();
     }
     llvm::Value* codeGeneration(CodeGenContext& context) override;
-
-    void traceReferences(std::function<void(GCObject*)> visitor) override {
-        for (auto& stmt : statementList) {
-            if (stmt) visitor(stmt.get());
-        }
-    }
 };
 
 class Condition : public Statement {
@@ -378,18 +346,15 @@ public:
         return s.str();
     }
     llvm::Value* codeGeneration(CodeGenContext& context) override;
-
-    void traceReferences(std::function<void(GCObject*)> visitor) override {
-        if (conditionExpr) visitor(conditionExpr.get());
-        if (ifBlock) visitor(ifBlock.get());
-        if (elseBlock) visitor(elseBlock.get());
-    }
 };
 
 class ForLoop : public Statement {
 public:
     std::unique_ptr<Expression> condition, update;
     std::unique_ptr<Statement> initializer, body;
+    // Accesses in the body indexed by the loop variable plus a constant, whose
+    // bounds checks are done once before the loop (see VisitorRangeAnalysis)
+    std::vector<std::pair<ArrayAccess*, int64_t>> hoistedChecks;
 
     ForLoop(std::unique_ptr<Statement> initializer, 
         std::unique_ptr<Expression> condition, 
@@ -406,13 +371,6 @@ public:
         return s.str();
     }
     llvm::Value* codeGeneration(CodeGenContext& context) override;
-
-    void traceReferences(std::function<void(GCObject*)> visitor) override {
-        if (initializer) visitor(initializer.get());
-        if (condition) visitor(condition.get());
-        if (update) visitor(update.get());
-        if (body) visitor(body.get());
-    }
 };
 
 class WhileLoop : public Statement {
@@ -429,11 +387,6 @@ public:
         return s.str();
     }
     llvm::Value* codeGeneration(CodeGenContext& context) override;
-
-    void traceReferences(std::function<void(GCObject*)> visitor) override {
-        if (condition) visitor(condition.get());
-        if (body) visitor(body.get());
-    }
 };
 
 class PrototypeFunction : public Statement {
@@ -441,9 +394,16 @@ public:
     std::string name;
     std::vector<std::pair<TokenType, std::string>> args;
     TokenType returnType;
+    // Which of the args are arrays, and whether the result is one. Their
+    // TokenType is then the element type.
+    std::vector<bool> arrayArgs;
+    bool returnsArray;
 
-    PrototypeFunction(std::string name, std::vector<std::pair<TokenType, std::string>> args, TokenType returnType) :
-        name(name), args(args), returnType(returnType){}
+    PrototypeFunction(std::string name, std::vector<std::pair<TokenType, std::string>> args, TokenType returnType,
+                      std::vector<bool> arrayArgs = {}, bool returnsArray = false) :
+        name(name), args(args), returnType(returnType), arrayArgs(arrayArgs), returnsArray(returnsArray){
+        this->arrayArgs.resize(this->args.size());
+    }
 
     void accept(Visitor& visitor) override;
     std::string toString() override {
@@ -469,11 +429,6 @@ public:
         return s.str();
     }
     llvm::Value* codeGeneration(CodeGenContext& context) override;
-
-    void traceReferences(std::function<void(GCObject*)> visitor) override {
-        if (prototype) visitor(prototype.get());
-        if (bodyBlock) visitor(bodyBlock.get());
-    }
 };
 
 class Return : public Statement {
@@ -488,8 +443,4 @@ public:
         return s.str();
     }
     llvm::Value* codeGeneration(CodeGenContext& context) override;
-
-    void traceReferences(std::function<void(GCObject*)> visitor) override {
-        if (expr) visitor(expr.get());
-    }
 };
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Arrays are referenced by a pointer to their first element. The element
+// size and length sit right in front of the data, on the heap and on the
+// stack alike, so code holding an array never needs to know where it lives.
+struct ArrayInfo {
+    // 0 for bool arrays, which pack 64 elements into each 64-bit word
+    uint64_t elementSize;
+    int64_t length;
+
+    static ArrayInfo *of(void *data) { return static_cast<ArrayInfo*>(data) - 1; }
+
+    // Bytes of element data an array of this shape takes
+    static uint64_t dataSize(int64_t length, uint64_t elementSize) {
+        return elementSize ? length * elementSize : (length + 63) / 64 * sizeof(uint64_t);
+    }
+};
+
+extern "C" {
+    // Returns the zeroed data of a new array on the current GC heap
+    void *dnm_array_new(int64_t length, int64_t elementSize);
+    // Copies the element at `value` into every element of the array. For bool
+    // arrays `value` points at one byte, 0 or 1.
+    void dnm_array_fill(void *data, const void *value);
+    // Reports an index --bounds-check caught and ends the program
+    [[noreturn]] void dnm_array_index_error(const char *name, int64_t index, int64_t length);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Arbitrary-precision integers (`bignum`). A value is a tagged 64-bit word:
+// odd words hold a 63-bit integer inline (value << 1 | 1), even words point at
+// a BigNum on the GC heap. Results that fit in 63 bits are always stored
+// inline, so a heap number is never small and zero is the word 1.
+struct BigNum {
+    // Variable slot allowed to update this number in place. Copying the value
+    // anywhere else sets it to SharedOwner, after which every update allocates.
+    const void *owner;
+    uint32_t length;        // limbs in use, the top one is non-zero
+    uint32_t capacity;
+    uint32_t negative;
+    uint32_t reserved;
+
+    // Magnitude, least significant 64-bit limb first
+    uint64_t *limbs() { return reinterpret_cast<uint64_t *>(this + 1); }
+};
+
+extern "C" {
+    int64_t dnm_big_from_i128(uint64_t low, int64_t high);
+
+    int64_t dnm_big_add(int64_t lhs, int64_t rhs);
+    int64_t dnm_big_sub(int64_t lhs, int64_t rhs);
+    int64_t dnm_big_mul(int64_t lhs, int64_t rhs);
+    // Truncating division, like the other integer types
+    int64_t dnm_big_div(int64_t lhs, int64_t rhs);
+    int64_t dnm_big_rem(int64_t lhs, int64_t rhs);
+    // -1, 0 or 1
+    int32_t dnm_big_compare(int64_t lhs, int64_t rhs);
+
+    // *slot = lhs op rhs, reusing the number in the slot when the slot owns it
+    void dnm_big_add_assign(int64_t *slot, int64_t lhs, int64_t rhs);
+    void dnm_big_sub_assign(int64_t *slot, int64_t lhs, int64_t rhs);
+    void dnm_big_mul_assign(int64_t *slot, int64_t lhs, int64_t rhs);
+
+    // Called by codegen when a value is copied to a second place
+    void dnm_big_share(int64_t value);
+
+    void dnm_print_big(int64_t value);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "GCBackend.h"
+
+// Runs programs on the Boehm-Demers-Weiser collector, for comparison with
+// GCManager. Boehm finds roots by scanning the machine stacks and data
+// segments conservatively, so the shadow stack is ignored and only REPL
+// globals, which live in JIT memory Boehm does not scan, are registered with
+// it. It collects inside allocations when it sees fit, never at safepoints.
+// Only built with DNM_WITH_BOEHM_GC (make main-boehm), which links libgc.
+class BoehmBackend final : public GCBackend {
+private:
+    std::vector<void*> globalRoots;
+    // Collections Boehm had run, process-wide, when the program started
+    size_t collectionsAtStart;
+    bool registeredThread = false;
+
+public:
+    // Sets up libgc; see GCBackend::initialize
+    static void initialize();
+
+    BoehmBackend();
+    BoehmBackend(const BoehmBackend&) = delete;
+    BoehmBackend& operator=(const BoehmBackend&) = delete;
+    ~BoehmBackend() override;
+
+    void* allocate(HeapKind kind, size_t size) override;
+    void collectGarbage() override;
+    void safepoint() override {}
+
+    void enterFrame(ShadowFrame*) override {}
+    void leaveFrame(ShadowFrame*) override {}
+    void addGlobalRoot(void* slot, HeapKind kind) override;
+
+    // The heap of the whole process, Boehm keeps no other
+    size_t getHeapBytes() const override;
+    size_t getCollections() const override;
+};
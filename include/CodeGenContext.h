@@ -15,6 +15,8 @@
 #include <map>
 #include <stack>
 #include "AST.h"
+#include "GCBackend.h"
+#include "VisitorEscapeAnalysis.h"
 
 class CodeGenBlock {
 public:
@@ -27,20 +29,64 @@ public:
 
 class CodeGenContext {
 private:
-    GCManager gcManager;
-    std::unique_ptr<llvm::orc::OwnProgLangJIT> JIT;
+    // Heap of the programs this context runs
+    std::unique_ptr<GCBackend> gcBackend = GCBackend::create();
+    std::unique_ptr<llvm::orc::OwnProgLangJIT> ownedJIT;
+    llvm::orc::OwnProgLangJIT *JIT;
+    llvm::orc::JITDylib *dylib;
+    std::vector<llvm::orc::ResourceTrackerSP> moduleTrackers;
+
+    // Declarations that outlive a single module, so later REPL inputs can use
+    // the globals and functions defined by earlier ones
+    std::map<std::string, llvm::Type*> globals;
+    std::map<std::string, llvm::FunctionType*> functions;
+    // Array types of each function's parameters followed by its result, null
+    // for the scalars. The LLVM signature only has a pointer for an array.
+    std::map<std::string, std::vector<llvm::Type*>> functionArrays;
+    // Slots of each function holding heap references, moved into its shadow
+    // stack frame once the function is complete (see createRootFrame)
+    std::map<llvm::Function*, std::vector<llvm::AllocaInst*>> rootSlots;
+    // Which arguments each function may return, for VisitorEscapeAnalysis
+    VisitorEscapeAnalysis::Summaries returnedArguments;
+    // Array declarations of each function, and whether each is kept in its
+    // frame. Keyed by node, as a versioned loop emits its body twice.
+    std::map<llvm::Function*, std::map<const ArrayDeclaration*, bool>> arrayAllocations;
+    // Constant of each string literal text of the module longer than an inline string
+    std::map<std::string, llvm::Constant*> stringLiterals;
 
 public:
     std::list<CodeGenBlock*> blocks;
     llvm::LLVMContext llvmContext;
     std::unique_ptr<llvm::Module> module;
     llvm::IRBuilder<> builder;
-    std::unique_ptr<llvm::Function> mainFunction;
+    llvm::Function *mainFunction = nullptr;
+    std::string mainFunctionName = "main";
+    // Top-level declarations become globals instead of locals of the entry function
+    bool globalTopLevel = false;
+    // Check array indexes at run time, except where VisitorRangeAnalysis proves them safe
+    bool boundsCheck = defaultBoundsCheck;
+    static bool defaultBoundsCheck;
+    // Top-level nodes that failed to compile and were left out of the module
+    size_t failedNodes = 0;
+
+    CodeGenContext() : builder(llvmContext), ownedJIT(std::move(*llvm::orc::OwnProgLangJIT::Create())) {
+        JIT = ownedJIT.get();
+        dylib = &JIT->getMainJITDylib();
+        module = std::make_unique<llvm::Module>("main", llvmContext);
+    }
+
+    // Compile into a JIT that outlives this context, e.g. when one process runs many scripts
+    CodeGenContext(llvm::orc::OwnProgLangJIT &jit) : CodeGenContext(jit, jit.getMainJITDylib()) {}
 
-    CodeGenContext() : builder(llvmContext), JIT(std::move(*llvm::orc::OwnProgLangJIT::Create())) {
+    CodeGenContext(llvm::orc::OwnProgLangJIT &jit, llvm::orc::JITDylib &dylib) :
+        builder(llvmContext), JIT(&jit), dylib(&dylib) {
         module = std::make_unique<llvm::Module>("main", llvmContext);
     }
 
+    ~CodeGenContext() {
+        releaseCode();
+    }
+
     std::map<std::string, std::pair<llvm::Value*, llvm::Type*>>& locals(){
         return blocks.back()->locals;
     }
@@ -48,6 +94,41 @@ public:
         return blocks.back()->block;
     }
 
+    bool isGlobalScope(){
+        return globalTopLevel && blocks.size() == 1 && builder.GetInsertBlock()->getParent() == mainFunction;
+    }
+
+    std::pair<llvm::Value*, llvm::Type*> lookupVariable(const std::string& name);
+    llvm::Function* lookupFunction(const std::string& name);
+    void declareGlobal(const std::string& name, llvm::Type* type);
+    void declareFunction(const std::string& name, llvm::FunctionType* type, std::vector<llvm::Type*> arrayTypes);
+    // Array type of a parameter of the function, or of its result for index
+    // == parameter count; null if that is not an array
+    llvm::Type* functionArrayType(const std::string& name, size_t index);
+
+    // Local slot of the current function for a bignum (i64), an array data
+    // pointer or a string, which the collector sees as a root
+    llvm::AllocaInst* createRootSlot(llvm::Type* type, const std::string& name);
+    // Keeps a heap value alive and up to date in a new root slot until the
+    // slot is written again; values live across a call are read back from it
+    llvm::AllocaInst* rootValue(llvm::Value* value);
+    // Makes a global variable holding a bignum, an array or a string a root
+    void registerGlobalRoot(llvm::GlobalVariable* global, HeapKind kind);
+    // Value of a string literal (see Strings.h): an inline word, or the one
+    // constant of the module with this text
+    llvm::Constant* internString(const std::string& text);
+    // Collects if a heap asked for it. Emitted at function entries and loop back edges.
+    void createSafepoint();
+    // Puts the root slots of a finished function into a shadow stack frame,
+    // pushed on entry and popped before every return. The entry safepoint
+    // goes after prologueEnd, the last store of a parameter, if any.
+    void createRootFrame(llvm::Function* function, llvm::Instruction* prologueEnd = nullptr);
+    // Counts an array declared by the current function, for the codegen=info
+    // report finishFunction writes
+    void countArrayAllocation(const ArrayDeclaration* declaration, bool onStack);
+    // Logs what a complete function does with its arrays
+    void finishFunction(llvm::Function* function);
+
     void pushBlock(llvm::BasicBlock* block){
         blocks.push_back(new CodeGenBlock(block));
     }
@@ -58,10 +139,14 @@ public:
         delete top;
     }
 
-    void generateCode(std::vector<std::unique_ptr<ASTNode>> nodeList);
-    void runCode();
+    // Compiles the nodes into a new module whose entry function is mainFunctionName.
+    // Can be called repeatedly; each call adds one more module to the dylib.
+    bool generateCode(std::vector<std::unique_ptr<ASTNode>> nodeList);
+    bool runCode();
+    // Frees the compiled code and data of every unit added by this context; the JIT itself stays alive
+    void releaseCode();
 
-    GCManager& getGCManager() {
-        return gcManager;
+    GCBackend& getGCBackend() {
+        return *gcBackend;
     }
 };
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "GCHeap.h"
+
+// Frame of a compiled function on the shadow stack. Compiled code keeps every
+// heap reference it holds in the slots of its frame, so a collection finds
+// them precisely instead of scanning the machine stack.
+struct ShadowFrame {
+    ShadowFrame *previous;
+    // Tagged bignum words come first, then array data pointers and strings,
+    // which the collector handles alike
+    uint32_t bignumSlots;
+    uint32_t arraySlots;
+
+    uint64_t *slots() { return reinterpret_cast<uint64_t *>(this + 1); }
+};
+
+// The collector behind a running program. Compiled code and the runtime only
+// talk to it through this interface, by way of the dnm_gc_* entry points and
+// the allocation functions of the runtime, so a backend can be picked when
+// the process starts without compiling anything differently.
+class GCBackend {
+public:
+    enum Kind {
+        // GCManager: precise, generational, compacting the nursery
+        PRECISE,
+        // The Boehm-Demers-Weiser conservative collector
+        BOEHM
+    };
+
+    // Backend of new programs
+    static Kind defaultKind;
+
+    // Whether this build can run the backend
+    static bool isAvailable(Kind kind);
+    // Sets up the process for the backend; called once, from the main thread,
+    // before any program runs
+    static void initialize(Kind kind);
+    static std::unique_ptr<GCBackend> create(Kind kind = defaultKind);
+
+    virtual ~GCBackend() = default;
+
+    // Returns zeroed payload memory of `size` bytes, 16-byte aligned, behind a HeapHeader
+    virtual void* allocate(HeapKind kind, size_t size) = 0;
+    // Collects now
+    virtual void collectGarbage() = 0;
+    // Collects if the backend asked compiled code for it through dnm_gc_requested
+    virtual void safepoint() = 0;
+
+    // Roots: the shadow stack frames of compiled functions, and global
+    // variables of REPL sessions holding heap references
+    virtual void enterFrame(ShadowFrame* frame) = 0;
+    virtual void leaveFrame(ShadowFrame* frame) = 0;
+    virtual void addGlobalRoot(void* slot, HeapKind kind) = 0;
+    // Drops the frames a runtime error jumped out of without leaving them
+    virtual void abandonFrames() {}
+
+    virtual size_t getHeapBytes() const = 0;
+    virtual size_t getCollections() const = 0;
+
+    // Heap the runtime allocates from on this thread; set while compiled code runs
+    static GCBackend* current();
+    static void setCurrent(GCBackend* backend);
+};
+
+extern "C" {
+    // Number of heaps waiting for a collection. Compiled code reads it at its
+    // safepoints and only calls dnm_gc_safepoint while it is non-zero.
+    extern std::atomic<int32_t> dnm_gc_requested;
+
+    void dnm_gc_enter(ShadowFrame *frame);
+    void dnm_gc_leave(ShadowFrame *frame);
+    // Registers a global variable slot; kind is a HeapKind
+    void dnm_gc_add_global(void *slot, uint32_t kind);
+    void dnm_gc_safepoint();
+}
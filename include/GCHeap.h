@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// Objects allocated by compiled programs
+enum class HeapKind : uint32_t {
+    Bignum = 1,
+    Array = 2,
+    String = 3,
+    // Nursery object copied to the old generation; its payload starts with
+    // the address of the copy
+    Forwarded = 4
+};
+
+// Precedes the payload of every heap object. Compiled code and the runtime
+// only see payload pointers; the header sits immediately in front.
+struct HeapHeader {
+    uint32_t kind;
+    // Mark of objects too big for a size class; cells are marked in their block
+    uint32_t marked;
+    uint64_t size;
+
+    void *payload() { return this + 1; }
+    static HeapHeader *of(void *payload) { return static_cast<HeapHeader*>(payload) - 1; }
+};
+
+// Heap of one running program. Small objects are bump allocated from blocks
+// that each hold cells of a single size class; mark bits and allocation bits
+// live in bitmaps at the start of the block, so marking never touches the
+// objects and a sweep walks each block's bitmaps linearly and rebuilds its
+// free list. Objects too big for a size class get their own allocation.
+// A heap is used by one thread at a time, the one running its program, except
+// for a concurrent sweep, which owns the blocks it was handed until it ends.
+class GCHeap {
+public:
+    static const size_t BlockSize = 256 * 1024;
+    static const size_t CellAlignment = 16;
+    // Largest cell, header included; bigger objects are allocated on their own
+    static const size_t MaxCellSize = 8192;
+    // Smaller heaps are swept by the collecting thread alone
+    static const size_t ParallelSweepBlocks = 32;
+
+    struct Stats {
+        size_t blocks = 0;
+        size_t largeObjects = 0;
+        // Bytes of live cells and large objects, headers included
+        size_t bytesInUse = 0;
+        // Bytes reserved from the system for blocks and large objects
+        size_t bytesReserved = 0;
+        // Bytes ever allocated and freed, headers included
+        size_t bytesAllocated = 0;
+        size_t bytesFreed = 0;
+    };
+
+    GCHeap();
+    GCHeap(const GCHeap&) = delete;
+    GCHeap& operator=(const GCHeap&) = delete;
+    ~GCHeap();
+
+    // Returns zeroed payload memory of `size` bytes, 16-byte aligned
+    void *allocate(HeapKind kind, size_t size);
+
+    // Marks the object live for the next sweep. Returns false if it already was.
+    bool mark(void *payload);
+    bool isMarked(void *payload) const;
+    // Whether the address is the payload of a live object of this heap. Safe
+    // to ask about any address, e.g. arrays on the stack, but not while a
+    // concurrent sweep is running.
+    bool contains(const void *payload) const;
+    // Bytes the object takes up in the heap, header and cell rounding included
+    size_t allocationSize(void *payload) const;
+    // Frees every object not marked since the last sweep and clears the marks.
+    // Large heaps are swept block by block on the GC worker threads.
+    void sweep();
+    // Sweeps like sweep(), but on a background thread. Everything allocated so
+    // far is handed to it, and allocation continues in fresh blocks meanwhile,
+    // so objects allocated during the sweep need no mark.
+    void startSweep();
+    // Takes back the blocks of a concurrent sweep once it has ended, waiting
+    // for it only if `wait` is set. Returns false if it is still running.
+    bool finishSweep(bool wait);
+    bool isSweeping() const { return sweeper.joinable(); }
+
+    const Stats &getStats() const { return stats; }
+
+private:
+    struct FreeCell {
+        FreeCell *next;
+    };
+
+    struct Block {
+        uint32_t sizeClass;
+        uint32_t cellSize;
+        uint32_t cellCount;
+        // Cells below bumpIndex have been handed out at least once
+        uint32_t bumpIndex;
+        uint32_t liveCells;
+        FreeCell *freeList;
+        uint64_t markBits[BlockSize / CellAlignment / 64];
+        uint64_t liveBits[BlockSize / CellAlignment / 64];
+
+        char *cells();
+        static Block *of(const void *address) {
+            return reinterpret_cast<Block*>(reinterpret_cast<uintptr_t>(address) & ~(uintptr_t(BlockSize) - 1));
+        }
+        size_t cellIndex(const void *address) { return (static_cast<const char*>(address) - cells()) / cellSize; }
+    };
+    static constexpr size_t CellsOffset = (sizeof(Block) + CellAlignment - 1) & ~(CellAlignment - 1);
+
+    struct SizeClass {
+        uint32_t cellSize;
+        std::vector<Block*> blocks;
+        // Blocks before it have neither free cells nor room to bump into
+        size_t allocationCursor = 0;
+    };
+
+    std::vector<SizeClass> sizeClasses;
+    // Size class of each cell size in CellAlignment steps, header included
+    std::vector<uint8_t> classOfSize;
+    // Blocks of all size classes, to tell heap addresses from others. A
+    // concurrent sweep releases blocks while new ones are allocated.
+    std::unordered_set<const Block*> allBlocks;
+    std::mutex allBlocksMutex;
+    std::unordered_set<HeapHeader*> largeObjects;
+    Stats stats;
+
+    // Objects being swept, the survivors once the sweep is done
+    std::vector<Block*> sweepBlocks;
+    std::unordered_set<HeapHeader*> sweepLargeObjects;
+    // What the sweep released, subtracted from stats when it is taken back
+    Stats released;
+    std::thread sweeper;
+    std::atomic<bool> sweepDone{false};
+
+    void *allocateSmall(SizeClass &sizeClass, uint32_t classIndex);
+    Block *newBlock(uint32_t classIndex);
+    static bool isLarge(const HeapHeader *header);
+    static size_t sweepBlock(Block *block);
+    void detachForSweep();
+    void sweepDetached();
+    void reattachSwept();
+};
@@ -1,25 +1,124 @@
-#include <unordered_set>
-#include <vector>
-#include <functional>
+#pragma once
 
-class GCObject {
-public:
-    bool marked = false;
-    virtual ~GCObject() = default;
-    virtual void traceReferences(std::function<void(GCObject*)> visitor) = 0;
-};
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "GCBackend.h"
+#include "GCHeap.h"
+#include "GCTelemetry.h"
+#include "Nursery.h"
 
-class GCManager {
+// Owns the heap of a running program and collects it. New objects start in
+// the nursery; a collection first moves the young objects still referenced
+// into the old generation, and only when that has grown enough marks and
+// sweeps the old generation too. None of the heap kinds refer to other heap
+// objects, so the roots are all a collection has to look at, and old objects
+// never point at young ones.
+// Collections only run at safepoints compiled code polls for, never inside an
+// allocation, so the runtime may hold on to what it allocates until it returns.
+// In concurrent mode a full collection only marks the roots while the program
+// waits and leaves the sweep to a background thread.
+class GCManager final : public GCBackend {
 private:
-    std::unordered_set<GCObject*> objects;
-    std::vector<GCObject*> roots;
-    void mark();
-    void markObject(GCObject* obj);
-    void sweep();
+    Nursery nursery;
+    GCHeap heap;
+    ShadowFrame *topFrame = nullptr;
+    // Global variables of REPL sessions holding heap references
+    std::vector<std::pair<void*, HeapKind>> globalRoots;
+    int growthPercent;
+    size_t heapLimit;
+    // Size of the old generation that makes the next collection a full one
+    size_t collectionThreshold;
+    // The old generation as of the last full collection: what it marked, and
+    // the heap's allocation count then. Sweeping may still be under way, so
+    // the old generation's size is estimated from these.
+    size_t liveBytesAtMark = 0;
+    size_t allocatedAtMark = 0;
+    bool concurrentSweep;
+    bool collectionRequested = false;
+    size_t collections = 0;
+    size_t fullCollections = 0;
+    GCTelemetry telemetry;
+    // Young bytes collections found unreferenced; the old generation counts its own
+    uint64_t youngBytesFreed = 0;
+
+    void* allocateOld(HeapKind kind, size_t size);
+    void requestCollection();
+    size_t nextThreshold(size_t liveBytes) const;
+    size_t oldGenerationBytes() const {
+        return liveBytesAtMark + heap.getStats().bytesAllocated - allocatedAtMark;
+    }
+    template <typename Visit> void updateRoots(Visit visit);
 
 public:
-    void addObject(GCObject* obj);
-    void addRoot(GCObject* root);
-    void removeRoot(GCObject* root);
-    void collectGarbage();
-};
\ No newline at end of file
+    static const size_t MinCollectionThreshold = 4 * 1024 * 1024;
+    // Nursery size of new managers, 0 to allocate everything in the old generation
+    static size_t defaultNurserySize;
+    // Whether new managers sweep the old generation on a background thread
+    static bool defaultConcurrentSweep;
+    // Growth of the old generation, in percent of what survived its last
+    // collection, that triggers the next full collection; negative to only
+    // collect it at the heap limit
+    static int defaultGrowthPercent;
+    // Bytes the nursery and the old generation may take together, 0 for no
+    // limit. The nursery is shrunk to a quarter of it if need be.
+    static size_t defaultHeapLimit;
+
+    // Largest share of the heap limit the nursery may take
+    static const size_t MaxNurseryLimitShare = 4;
+
+    GCManager()
+        : nursery(defaultHeapLimit ? std::min(defaultNurserySize, defaultHeapLimit / MaxNurseryLimitShare) : defaultNurserySize),
+          growthPercent(defaultGrowthPercent), heapLimit(defaultHeapLimit),
+          concurrentSweep(defaultConcurrentSweep) {
+        collectionThreshold = nextThreshold(0);
+    }
+    GCManager(const GCManager&) = delete;
+    GCManager& operator=(const GCManager&) = delete;
+    ~GCManager() override;
+
+    // Returns zeroed payload memory of `size` bytes, 16-byte aligned
+    void* allocate(HeapKind kind, size_t size) override {
+        telemetry.countAllocation(kind, size);
+        if (void* payload = nursery.allocate(kind, size)) {
+            return payload;
+        }
+        return allocateOld(kind, size);
+    }
+
+    void enterFrame(ShadowFrame* frame) override {
+        frame->previous = topFrame;
+        topFrame = frame;
+    }
+    void leaveFrame(ShadowFrame* frame) override {
+        topFrame = frame->previous;
+    }
+    void abandonFrames() override {
+        topFrame = nullptr;
+    }
+    void addGlobalRoot(void* slot, HeapKind kind) override {
+        globalRoots.emplace_back(slot, kind);
+    }
+
+    // Collects if the heap asked for it
+    void safepoint() override {
+        if (collectionRequested) {
+            collectGarbage();
+        }
+    }
+    // Moves the live young objects to the old generation, and frees the old
+    // objects not referenced from the shadow stack or a global root once the
+    // old generation has grown by the growth percentage since the last time,
+    // or is about to reach the heap limit. Ends the program with a runtime
+    // error if what is still referenced does not fit in the limit.
+    void collectGarbage() override;
+
+    size_t getHeapBytes() const override { return heap.getStats().bytesInUse + nursery.getBytesInUse(); }
+    const GCHeap::Stats& getHeapStats() const { return heap.getStats(); }
+    size_t getCollections() const override { return collections; }
+    size_t getFullCollections() const { return fullCollections; }
+    // A snapshot of what the collector has done so far
+    GCTelemetry getTelemetry() const;
+};
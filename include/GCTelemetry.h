@@ -0,0 +1,92 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "GCHeap.h"
+
+// Distribution of collection pauses, in power-of-two microsecond buckets
+struct PauseHistogram {
+    static const int Buckets = 32;
+    // Bucket i counts pauses shorter than 2^i microseconds and not shorter than half that
+    uint64_t counts[Buckets] = {};
+    uint64_t pauses = 0;
+    double totalMicroseconds = 0;
+    double maxMicroseconds = 0;
+
+    void record(double microseconds);
+    // Upper bound of the pause time below which `percent` of the pauses fall
+    double percentile(double percent) const;
+};
+
+// What the collector of one program has done so far. GCManager keeps it up
+// to date at every allocation and collection; hosts read it through
+// GCManager::getTelemetry, and --gc-stats writes it out when a program ends.
+struct GCTelemetry {
+    // Stop-the-world phases of a collection
+    enum Phase {
+        // Evacuating the nursery
+        MINOR,
+        // Marking the old generation from the roots
+        MARK,
+        // Sweeping it, or only starting the sweep in concurrent mode
+        SWEEP,
+        PHASE_COUNT
+    };
+
+    enum Format {
+        NONE,
+        TEXT,
+        JSON
+    };
+
+    struct Objects {
+        uint64_t count = 0;
+        // Headers included
+        uint64_t bytes = 0;
+    };
+
+    struct HeapSample {
+        double milliseconds;
+        size_t bytes;
+    };
+
+    // Bignums, arrays and strings, indexed by HeapKind
+    static const int Kinds = 4;
+    // Every pause, and each phase on its own
+    PauseHistogram pauses;
+    PauseHistogram phases[PHASE_COUNT];
+    Objects allocated[Kinds];
+    // Referenced at the last full collection
+    Objects live[Kinds];
+    uint64_t bytesFreed = 0;
+    // Young bytes that survived into the old generation
+    uint64_t bytesPromoted = 0;
+    // Old generation size after each collection; halved, every other sample dropped,
+    // whenever it reaches MaxHeapSamples
+    std::vector<HeapSample> heapSizes;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    static const size_t MaxHeapSamples = 512;
+    // How GCManager writes it to stderr on destruction
+    static Format dumpFormat;
+
+    void countAllocation(HeapKind kind, size_t size) {
+        Objects &objects = allocated[static_cast<uint32_t>(kind)];
+        objects.count++;
+        objects.bytes += sizeof(HeapHeader) + size;
+    }
+    void sampleHeap(size_t bytes);
+
+    // `heap` describes the program's heap as it is now
+    void writeText(std::ostream &out, const GCHeap::Stats &heap) const;
+    void writeJSON(std::ostream &out, const GCHeap::Stats &heap) const;
+
+    static const char *phaseName(Phase phase);
+
+private:
+    size_t sampleStride = 1;
+    size_t samplesSkipped = 0;
+};
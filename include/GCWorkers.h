@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads shared by the collectors of every heap in the process. A job is a
+// number of independent tasks; the calling thread and the workers claim them
+// from a shared counter until none are left, so whoever finishes early takes
+// over the rest. Only one job runs at a time: a collector that finds the
+// workers busy runs its job alone.
+class GCWorkers {
+public:
+    // Threads taking part in a job, the calling one included
+    static unsigned defaultThreads;
+
+    static GCWorkers& instance();
+
+    // Calls task(index) for every index below count
+    template <typename Task>
+    void parallelFor(size_t count, Task& task) {
+        run(count, [](void* context, size_t index) { (*static_cast<Task*>(context))(index); }, &task);
+    }
+
+    unsigned getThreads() const { return threads; }
+
+private:
+    using TaskFunction = void (*)(void* context, size_t index);
+
+    unsigned threads;
+    std::vector<std::thread> workers;
+    std::mutex jobMutex;
+
+    // The current job, guarded by stateMutex
+    std::mutex stateMutex;
+    std::condition_variable jobReady, jobDone;
+    TaskFunction task = nullptr;
+    void* context = nullptr;
+    size_t taskCount = 0;
+    std::atomic<size_t> nextTask{0};
+    unsigned busyWorkers = 0;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    explicit GCWorkers(unsigned threads);
+    ~GCWorkers();
+    void run(size_t count, TaskFunction function, void* functionContext);
+    void runTasks();
+    void workerLoop();
+};
@@ -12,6 +12,7 @@ class Lexer
     std::map<std::string, TokenType> keywords = {
         {"int", INT},
         {"bigint", BIGINT},
+        {"bignum", BIGNUM},
         {"float", FLOAT},
         {"string", STR},
         {"char", CHAR},
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Leveled, per-category diagnostics. Everything is off by default; a disabled
+// DNM_LOG statement costs one compare and never evaluates its operands.
+//
+//     DNM_LOG(CODEGEN, DEBUG) << "Assigned type - int32";
+//
+// Building with -DDNM_NO_LOGGING removes the statements entirely.
+class Log {
+public:
+    enum Category {
+        LEXER,
+        PARSER,
+        CODEGEN,
+        JIT,
+        GC,
+        CATEGORY_COUNT
+    };
+
+    enum Level {
+        OFF,
+        INFO,
+        DEBUG,
+        TRACE
+    };
+
+    // Compiler artifacts that can be written to a file on request
+    enum Artifact {
+        TOKENS,
+        AST,
+        IR,
+        OPTIMIZED_IR,
+        ARTIFACT_COUNT
+    };
+
+    static bool isEnabled(Category category, Level level) {
+        return levels[category] >= level;
+    }
+
+    // Parses "codegen=debug,jit" style specifications; "all" names every category
+    // and a category without a level means DEBUG. Returns false on unknown names.
+    static bool configure(const std::string &spec);
+    static void setLevel(Category category, Level level) { levels[category] = level; }
+
+    static void setDumpPath(Artifact artifact, const std::string &path) { dumpPaths[artifact] = path; }
+    static const std::string &getDumpPath(Artifact artifact) { return dumpPaths[artifact]; }
+    static bool isDumpEnabled(Artifact artifact) { return !dumpPaths[artifact].empty(); }
+    // The first write of a run truncates the file, later ones (more modules) append
+    static void writeDump(Artifact artifact, const std::string &text);
+
+    static const char *categoryName(Category category);
+
+    // Collects one message and writes it to stderr as a single line
+    class Line {
+        std::ostringstream stream;
+    public:
+        Line(Category category);
+        ~Line();
+        template <typename T>
+        Line &operator<<(const T &value) {
+            stream << value;
+            return *this;
+        }
+    };
+
+private:
+    static Level levels[CATEGORY_COUNT];
+    static std::string dumpPaths[ARTIFACT_COUNT];
+    static bool dumpStarted[ARTIFACT_COUNT];
+};
+
+#ifdef DNM_NO_LOGGING
+#define DNM_LOG(category, level) if (true) ; else Log::Line(Log::category)
+#else
+#define DNM_LOG(category, level) if (!Log::isEnabled(Log::category, Log::level)) ; else Log::Line(Log::category)
+#endif
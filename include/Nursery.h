@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "GCHeap.h"
+
+// Young generation: one contiguous buffer that objects are bump allocated
+// from. A minor collection copies the objects still referenced into the old
+// generation and resets the buffer, so its cost follows the surviving young
+// data rather than everything allocated since.
+class Nursery {
+public:
+    // Bigger objects go straight to the old generation
+    static const size_t MaxObjectSize = 4096;
+
+    explicit Nursery(size_t capacity) : capacity(capacity & ~(GCHeap::CellAlignment - 1)) {}
+    Nursery(const Nursery&) = delete;
+    Nursery& operator=(const Nursery&) = delete;
+    ~Nursery();
+
+    // Returns zeroed payload memory, or nullptr when the object does not fit
+    void *allocate(HeapKind kind, size_t size) {
+        if (size > MaxObjectSize) {
+            return nullptr;
+        }
+        size_t total = (sizeof(HeapHeader) + size + GCHeap::CellAlignment - 1) & ~(GCHeap::CellAlignment - 1);
+        if (total > MaxObjectSize || total > size_t(end - top)) {
+            return nullptr;
+        }
+        HeapHeader *header = reinterpret_cast<HeapHeader *>(top);
+        top += total;
+        header->kind = static_cast<uint32_t>(kind);
+        header->size = size;
+        return header->payload();
+    }
+    // Whether a later allocate of this size can succeed after a reset
+    bool accepts(size_t size) const;
+    // Reserves the buffer, which only happens once the program allocates
+    void reserve();
+    bool isReserved() const { return start != nullptr; }
+
+    bool contains(const void *payload) const {
+        return payload > static_cast<const void *>(start) && payload < static_cast<const void *>(top);
+    }
+    // Copies a young object into the old generation, once: later calls for
+    // the same object return the same copy
+    void *evacuate(void *payload, GCHeap &oldGeneration);
+    // Forgets every object, all of them evacuated or dead
+    void reset();
+
+    size_t getCapacity() const { return capacity; }
+    size_t getBytesInUse() const { return top - start; }
+
+private:
+    size_t capacity;
+    char *start = nullptr;
+    char *top = nullptr;
+    char *end = nullptr;
+};
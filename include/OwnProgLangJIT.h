@@ -22,6 +22,13 @@
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Scalar/GVN.h"
 #include "AST.h"
+#include "SlabMemoryManager.h"
+#include "Runtime.h"
+#include "Bignum.h"
+#include "Array.h"
+#include "Strings.h"
+#include "GCBackend.h"
+#include <atomic>
 #include <memory>
 
 extern "C" void ___chkstk_ms();
@@ -31,6 +38,7 @@ namespace llvm {
         class OwnProgLangJIT {
         private:
             std::unique_ptr<ExecutionSession> ES;
+            SlabPool MemoryPool;
             RTDyldObjectLinkingLayer ObjectLayer;
             IRCompileLayer CompileLayer;
             IRTransformLayer TransformLayer;
@@ -40,28 +48,41 @@ namespace llvm {
             ThreadSafeContext Ctx;
 
             JITDylib &MainJD;
+            std::atomic<unsigned> ScriptCount{0};
 
         public:
             OwnProgLangJIT(std::unique_ptr<ExecutionSession> ES, JITTargetMachineBuilder JTMB, DataLayout DL)
                 : ES(std::move(ES)), DL(std::move(DL)), Mangle(*this->ES, this->DL),
-                  ObjectLayer(*this->ES, []() { return std::make_unique<SectionMemoryManager>(); }),
+                  ObjectLayer(*this->ES, [this]() { return std::make_unique<SlabMemoryManager>(MemoryPool); }),
                   CompileLayer(*this->ES, ObjectLayer, std::make_unique<ConcurrentIRCompiler>(std::move(JTMB))),
                   TransformLayer(*this->ES, CompileLayer, optimizeModule),
                   MainJD(this->ES->createBareJITDylib("<main>")) {
                 MainJD.addGenerator(
                     cantFail(DynamicLibrarySearchGenerator::GetForCurrentProcess(DL.getGlobalPrefix())));
                 registerChkStkMsSymbol();
+                registerRuntimeSymbols();
             }
 
             static Expected<std::unique_ptr<OwnProgLangJIT> > Create();
 
             Error addModule(ThreadSafeModule TSM, ResourceTrackerSP RT = nullptr);
 
+            // Each compiled unit gets its own tracker so its code and data can be freed
+            // once the unit is superseded or has finished running.
+            Error removeModule(ResourceTrackerSP RT);
+
+            // A dylib per script keeps the scripts' symbols apart while they share the
+            // session, the runtime symbols and the process symbol resolution of MainJD.
+            Expected<JITDylib &> createScriptDylib(StringRef Name);
+            Error removeScriptDylib(JITDylib &JD);
+
             llvm::Expected<llvm::orc::ExecutorSymbolDef> lookup(llvm::StringRef Name);
+            llvm::Expected<llvm::orc::ExecutorSymbolDef> lookup(JITDylib &JD, llvm::StringRef Name);
 
             const llvm::DataLayout &getDataLayout() const { return DL; }
             JITDylib &getMainJITDylib() { return MainJD; }
             std::unique_ptr<ExecutionSession> &getExecutionSession() { return ES; }
+            SlabPool::Stats getMemoryStats() const { return MemoryPool.getStats(); }
 
         private:
             static Expected<ThreadSafeModule> optimizeModule(ThreadSafeModule TSM,
@@ -76,6 +97,56 @@ namespace llvm {
                 cantFail(MainJD.define(llvm::orc::absoluteSymbols(std::move(Symbols))));
             }
 
+            void registerRuntimeSymbols() {
+                llvm::orc::SymbolMap Symbols;
+                auto Add = [&](StringRef Name, auto *Function) {
+                    Symbols[Mangle(Name)] = {llvm::orc::ExecutorAddr::fromPtr(Function),
+                                             llvm::JITSymbolFlags::Exported};
+                };
+
+                // Shadows the C library printf so output goes to the thread's OutputSink
+                Add("printf", &dnm_printf);
+
+                Add("dnm_print_i32", &dnm_print_i32);
+                Add("dnm_print_i64", &dnm_print_i64);
+                Add("dnm_print_f64", &dnm_print_f64);
+                Add("dnm_print_char", &dnm_print_char);
+                Add("dnm_print_str", &dnm_print_str);
+                Add("dnm_print_i128", &dnm_print_i128);
+                Add("dnm_i128_divrem", &dnm_i128_divrem);
+                Add("dnm_division_error", &dnm_division_error);
+
+                Add("dnm_big_from_i128", &dnm_big_from_i128);
+                Add("dnm_big_add", &dnm_big_add);
+                Add("dnm_big_sub", &dnm_big_sub);
+                Add("dnm_big_mul", &dnm_big_mul);
+                Add("dnm_big_div", &dnm_big_div);
+                Add("dnm_big_rem", &dnm_big_rem);
+                Add("dnm_big_compare", &dnm_big_compare);
+                Add("dnm_big_add_assign", &dnm_big_add_assign);
+                Add("dnm_big_sub_assign", &dnm_big_sub_assign);
+                Add("dnm_big_mul_assign", &dnm_big_mul_assign);
+                Add("dnm_big_share", &dnm_big_share);
+                Add("dnm_print_big", &dnm_print_big);
+
+                Add("dnm_str_concat", &dnm_str_concat);
+                Add("dnm_str_append", &dnm_str_append);
+                Add("dnm_str_compare", &dnm_str_compare);
+                Add("dnm_str_share", &dnm_str_share);
+
+                Add("dnm_array_new", &dnm_array_new);
+                Add("dnm_array_fill", &dnm_array_fill);
+                Add("dnm_array_index_error", &dnm_array_index_error);
+
+                Add("dnm_gc_requested", &dnm_gc_requested);
+                Add("dnm_gc_enter", &dnm_gc_enter);
+                Add("dnm_gc_leave", &dnm_gc_leave);
+                Add("dnm_gc_add_global", &dnm_gc_add_global);
+                Add("dnm_gc_safepoint", &dnm_gc_safepoint);
+
+                cantFail(MainJD.define(llvm::orc::absoluteSymbols(std::move(Symbols))));
+            }
+
         };
     }
 }
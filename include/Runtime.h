@@ -0,0 +1,73 @@
+#pragma once
+
+#include <csetjmp>
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+
+// Functions JIT-compiled code calls into. They are registered as absolute
+// symbols in the JIT, so their names must stay in sync with codegen.
+extern "C" {
+    int dnm_printf(const char *format, ...);
+
+    // Writers behind `print`: each writes the value and a newline into the
+    // thread's print buffer without going through a format string. Values
+    // narrower than 32 bits are widened by codegen so no ABI extension rules
+    // are involved; bool prints through dnm_print_i32. Bignums and strings
+    // have theirs next to their runtime, in Bignum.h and Strings.h.
+    void dnm_print_i32(int32_t value);
+    void dnm_print_i64(int64_t value);
+    void dnm_print_f64(double value);
+    void dnm_print_char(int32_t value);
+
+    // bigint (i128) support. Values cross the boundary as 64-bit halves,
+    // which every C++ compiler and calling convention agree on.
+    void dnm_print_i128(uint64_t low, int64_t high);
+    // Writes {quotient low, quotient high, remainder low, remainder high}.
+    // Codegen divides inline when both operands fit in 64 bits and only
+    // calls this for the wide cases.
+    void dnm_i128_divrem(uint64_t lhsLow, int64_t lhsHigh, uint64_t rhsLow, int64_t rhsHigh, uint64_t *result);
+
+    // Reports an integer division codegen caught before it could trap, a zero
+    // divisor or MIN / -1 when `overflow` is set, and ends the program
+    [[noreturn]] void dnm_division_error(int32_t overflow);
+}
+
+// Destination of everything a script prints. It is per thread, so scripts
+// running side by side in one process keep their output apart.
+class OutputSink {
+public:
+    virtual ~OutputSink() = default;
+    virtual void write(const char *data, size_t size) = 0;
+    virtual void flush() {}
+};
+
+class FileOutputSink : public OutputSink {
+    FILE *file;
+public:
+    FileOutputSink(FILE *file) : file(file) {}
+    void write(const char *data, size_t size) override { fwrite(data, 1, size, file); }
+    void flush() override { fflush(file); }
+};
+
+// Output is collected in a per-thread buffer and handed to the sink in large
+// writes. Switching sinks flushes the buffer into the previous one first.
+// nullptr restores the default sink, stdout.
+void setOutputSink(OutputSink *sink);
+OutputSink &getOutputSink();
+
+// Appends to the thread's print buffer, for runtime code printing on its own
+void appendOutput(const char *data, size_t size);
+
+// Hands the buffered output to the sink and flushes the sink
+void flushOutput();
+
+// Where runtime errors of the program running on this thread jump to, set by
+// CodeGenContext::runCode around the call into compiled code. Returns the
+// previous one, nullptr for none.
+std::jmp_buf *setRuntimeErrorJump(std::jmp_buf *jump);
+
+// Ends the program running on this thread after the caller has printed what
+// went wrong: runCode returns false, and the process, e.g. a --serve daemon,
+// carries on. Without a running program the process aborts.
+[[noreturn]] void runtimeError();
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "OwnProgLangJIT.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Compile-and-run daemon listening on a Unix domain socket. The JIT stays
+// resident, so a request only pays for compiling and running its script.
+//
+// Protocol, one request per connection:
+//   client -> server   "RUN <path>\n"  or  "SOURCE <length>\n<length bytes of source>"
+//   server -> client   any number of "OUT <length>\n<length bytes>" frames with the
+//                      script's output, an "ERR <length>\n<length bytes>" frame with
+//                      the compile or runtime errors if there were any, then
+//                      "EXIT <status>\n"
+class CompileServer {
+    llvm::orc::OwnProgLangJIT &jit;
+    std::string socketPath;
+    unsigned workerCount;
+    int listenFd = -1;
+
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    std::deque<int> pendingClients;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    void workerLoop();
+    void handleClient(int clientFd);
+    int compileAndRun(const std::string &name, const std::string &sourceCode, int clientFd);
+
+public:
+    CompileServer(llvm::orc::OwnProgLangJIT &jit, std::string socketPath, unsigned workerCount) :
+        jit(jit), socketPath(std::move(socketPath)), workerCount(workerCount) {}
+
+    // Serves until SIGINT/SIGTERM, returns the process exit code
+    int run();
+};
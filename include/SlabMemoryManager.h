@@ -0,0 +1,110 @@
+#pragma once
+
+#include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
+#include "llvm/Support/Alignment.h"
+#include "llvm/Support/Memory.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace llvm {
+    namespace orc {
+        // Large pre-reserved regions that all JIT'd objects carve their sections from.
+        // Code from every module is packed back to back in the same code slabs, so
+        // compiled code stays on few pages instead of one mapping per module.
+        // Slabs are ordinary base-page mappings: transparent huge pages are out of
+        // scope, since every object's ranges get their own protection when it is
+        // finalized, which splits the mapping and any huge page behind it.
+        class SlabPool {
+        public:
+            enum SlabKind {
+                CODE,
+                READ_ONLY_DATA,
+                READ_WRITE_DATA,
+                SLAB_KIND_COUNT
+            };
+
+            struct Stats {
+                uint64_t bytesReserved = 0;   // mapped from the OS for slabs
+                uint64_t bytesUsed = 0;       // handed out to live sections
+                uint64_t bytesFragmented = 0; // carved or freed but unusable until the slab is recycled
+                unsigned slabCount = 0;
+                unsigned freeSlabCount = 0;
+            };
+
+            // A page-aligned piece of a slab owned by one object.
+            struct Range {
+                void *slab = nullptr;
+                uint8_t *base = nullptr;
+                size_t size = 0;
+            };
+
+            static const size_t DefaultSlabSize = 4 * 1024 * 1024;
+
+            explicit SlabPool(size_t slabSize = DefaultSlabSize);
+            ~SlabPool();
+
+            SlabPool(const SlabPool &) = delete;
+            SlabPool &operator=(const SlabPool &) = delete;
+
+            Range carve(SlabKind kind, size_t size);
+            void release(const Range &range, size_t bytesUsed);
+            void noteUsed(size_t bytes);
+
+            Stats getStats() const;
+
+        private:
+            struct Slab {
+                sys::MemoryBlock block;
+                SlabKind kind;
+                size_t offset = 0;      // bump pointer
+                size_t liveBytes = 0;   // carved bytes still owned by objects
+                unsigned liveRanges = 0;
+            };
+
+            size_t slabSize;
+            size_t pageSize;
+            mutable std::mutex mutex;
+            std::vector<std::unique_ptr<Slab>> slabs;
+            std::vector<std::unique_ptr<Slab>> freeSlabs;
+            Slab *current[SLAB_KIND_COUNT] = {};
+            uint64_t bytesUsed = 0;
+
+            Slab *newSlab(SlabKind kind, size_t minSize);
+            void recycle(Slab *slab);
+        };
+
+        // Per-object memory manager handed to RTDyldObjectLinkingLayer. It owns the
+        // ranges carved for one object and gives them back to the pool when the
+        // object is unloaded (its ResourceTracker removed).
+        class SlabMemoryManager : public RTDyldMemoryManager {
+        public:
+            explicit SlabMemoryManager(SlabPool &pool) : pool(pool) {}
+            ~SlabMemoryManager() override;
+
+            uint8_t *allocateCodeSection(uintptr_t Size, unsigned Alignment, unsigned SectionID,
+                                         StringRef SectionName) override;
+            uint8_t *allocateDataSection(uintptr_t Size, unsigned Alignment, unsigned SectionID,
+                                         StringRef SectionName, bool IsReadOnly) override;
+
+            bool needsToReserveAllocationSpace() override { return true; }
+            void reserveAllocationSpace(uintptr_t CodeSize, Align CodeAlign, uintptr_t RODataSize,
+                                        Align RODataAlign, uintptr_t RWDataSize, Align RWDataAlign) override;
+
+            bool finalizeMemory(std::string *ErrMsg = nullptr) override;
+
+        private:
+            struct Region {
+                SlabPool::Range range;
+                size_t offset = 0;
+                size_t used = 0;
+            };
+
+            SlabPool &pool;
+            std::vector<Region> regions[SlabPool::SLAB_KIND_COUNT];
+
+            uint8_t *allocate(SlabPool::SlabKind kind, uintptr_t size, unsigned alignment);
+        };
+    }
+}
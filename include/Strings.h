@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Strings (`string`). A value is a tagged 64-bit word. Odd words hold up to
+// seven bytes inline: the length in bits 1 to 3 and the bytes from bit 8 up,
+// first byte lowest. Even words point at the characters of a string on the GC
+// heap or, for literals, in the constants of the compiled module, with the
+// StringInfo right in front, as arrays have their ArrayInfo. Strings of up to
+// seven bytes are always held inline, so two inline words are equal exactly
+// when their strings are, and the empty string is the word 1.
+struct StringInfo {
+    // Variable slot allowed to append to this string in place, null if none
+    // is. Copying the value anywhere else clears it.
+    const void *owner;
+    uint64_t length;
+
+    static const size_t MaxInlineLength = 7;
+
+    static StringInfo *of(const char *chars) {
+        return reinterpret_cast<StringInfo *>(const_cast<char *>(chars)) - 1;
+    }
+    static uint64_t inlineWord(const char *chars, size_t length) {
+        uint64_t word = length << 1 | 1;
+        for (size_t i = 0; i < length; i++) {
+            word |= uint64_t(static_cast<uint8_t>(chars[i])) << (8 + 8 * i);
+        }
+        return word;
+    }
+};
+
+extern "C" {
+    // lhs followed by rhs
+    const char *dnm_str_concat(const char *lhs, const char *rhs);
+    // *slot = *slot followed by rhs, appending in place when the slot owns its
+    // string and there is room. Strings made for a slot get headroom, so a
+    // string built up in a loop is not copied over again on every iteration.
+    void dnm_str_append(const char **slot, const char *rhs);
+    // -1, 0 or 1, comparing bytes as unsigned
+    int32_t dnm_str_compare(const char *lhs, const char *rhs);
+
+    // Called by codegen when a value is copied to a second place
+    void dnm_str_share(const char *value);
+
+    // Writes the string and a newline, see Runtime.h
+    void dnm_print_str(const char *value);
+}
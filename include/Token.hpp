@@ -57,6 +57,7 @@ enum TokenType {
     // Keywords
     INT,
     BIGINT,
+    BIGNUM,
     FLOAT,
     STR,
     CHAR,
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Visitor.h"
+#include <map>
+#include <set>
+#include <string>
+
+// Collects how a function body uses arrays, so codegen can tell which array
+// parameters are only read, kept or possibly aliased. Names are not resolved
+// to declarations: a local array shadowing a parameter counts as the
+// parameter, which can only cost attributes, never add wrong ones.
+class VisitorArrayUsage : public Visitor {
+public:
+    std::set<std::string> read, written;
+    // Identifiers passed to functions and returned
+    std::set<std::string> passed, returned;
+    // Arrays created in the body, and arrays bound to another array or to
+    // what a call returned
+    std::set<std::string> declared, bound;
+    // Names bound to each name by `array T b = a;`
+    std::map<std::string, std::set<std::string>> boundTo;
+    // Something other than a plain identifier is returned
+    bool returnsExpression = false;
+    bool hasCall = false;
+
+    virtual ~VisitorArrayUsage() = default;
+
+    // The name and every name bound to it, directly or through another
+    std::set<std::string> aliasesOf(const std::string& name) const;
+    // Whether the name or one of its aliases is in names
+    bool usedAs(const std::set<std::string>& names, const std::string& name) const;
+
+    void visitExpression(Expression& node);
+    void visitStatement(Statement& node);
+    void visitIntegerLiteral(IntegerLiteral& node);
+    void visitFloatLiteral(FloatLiteral& node);
+    void visitStringLiteral(StringLiteral& node);
+    void visitCharLiteral(CharLiteral& node);
+    void visitBoolLiteral(BoolLiteral& node);
+    void visitIdentifier(Identifier& node);
+    void visitUnary(Unary& node);
+    void visitBinary(Binary& node);
+    void visitComparison(Comparison& node);
+    void visitCallFunction(CallFunction& node);
+    void visitArrayAccess(ArrayAccess& node);
+    void visitAssignment(Assignment& node);
+    void visitExpressionStatement(ExpressionStatement& node);
+    void visitArrayDeclaration(ArrayDeclaration& node);
+    void visitVariableDeclaration(VariableDeclaration& node);
+    void visitPrint(Print& node);
+    void visitBlock(Block& node);
+    void visitCondition(Condition& node);
+    void visitForLoop(ForLoop& node);
+    void visitWhileLoop(WhileLoop& node);
+    void visitPrototypeFunction(PrototypeFunction& node);
+    void visitFunction(FunctionNode& node);
+    void visitReturn(Return& node);
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Visitor.h"
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+// Finds the arrays that cannot outlive the function declaring them, so codegen
+// may keep them in the function's frame instead of on the GC heap. No heap
+// object holds references and array variables are never reassigned, so the
+// only way out of a function is its return value: an array escapes when it is
+// returned, bound to a name that escapes (`array int b = a;`), or passed to a
+// call that may return that argument. Which arguments a function may return
+// is summarized per function and solved to a fixpoint over the unit, so
+// recursion is covered; the summaries outlive the unit, for later REPL inputs.
+// Names are not resolved to declarations: arrays of one function sharing a
+// name are treated as one, which can only make more of them escape.
+class VisitorEscapeAnalysis : public Visitor {
+public:
+    // Whether each argument of a function may be its result
+    using Summaries = std::map<std::string, std::vector<bool>>;
+
+private:
+    Summaries &summaries;
+    // Of the body being visited: the names each name is bound to, the names
+    // returned, and the array declarations
+    std::map<std::string, std::set<std::string>> boundTo;
+    std::set<std::string> returned;
+    std::vector<ArrayDeclaration *> declarations;
+
+    // Names whose array the value of expr may be
+    std::set<std::string> sourcesOf(Expression *expr) const;
+    // Clears what was collected for the previous body
+    void startBody();
+    // Names of the visited body whose array may be returned from it
+    std::set<std::string> escapingNames() const;
+
+public:
+    VisitorEscapeAnalysis(Summaries &summaries) : summaries(summaries) {}
+    virtual ~VisitorEscapeAnalysis() = default;
+
+    // Sets ArrayDeclaration::escapes for the declarations of one compilation
+    // unit; top-level statements count as the body of one more function
+    void run(std::vector<std::unique_ptr<ASTNode>> &nodeList);
+
+    void visitExpression(Expression& node);
+    void visitStatement(Statement& node);
+    void visitIntegerLiteral(IntegerLiteral& node);
+    void visitFloatLiteral(FloatLiteral& node);
+    void visitStringLiteral(StringLiteral& node);
+    void visitCharLiteral(CharLiteral& node);
+    void visitBoolLiteral(BoolLiteral& node);
+    void visitIdentifier(Identifier& node);
+    void visitUnary(Unary& node);
+    void visitBinary(Binary& node);
+    void visitComparison(Comparison& node);
+    void visitCallFunction(CallFunction& node);
+    void visitArrayAccess(ArrayAccess& node);
+    void visitAssignment(Assignment& node);
+    void visitExpressionStatement(ExpressionStatement& node);
+    void visitArrayDeclaration(ArrayDeclaration& node);
+    void visitVariableDeclaration(VariableDeclaration& node);
+    void visitPrint(Print& node);
+    void visitBlock(Block& node);
+    void visitCondition(Condition& node);
+    void visitForLoop(ForLoop& node);
+    void visitWhileLoop(WhileLoop& node);
+    void visitPrototypeFunction(PrototypeFunction& node);
+    void visitFunction(FunctionNode& node);
+    void visitReturn(Return& node);
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Visitor.h"
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Values an int expression can take at run time, both ends inclusive
+struct ValueRange {
+    int64_t low, high;
+};
+
+// Finds the array accesses --bounds-check does not need to check. Ranges come
+// from int variables that are never assigned after their declaration and from
+// the variables of counted for loops; an access whose index range lies inside
+// the array's constant length is marked inBounds. In an innermost loop that
+// counts up by one, accesses indexed by the loop variable plus a constant are
+// recorded in ForLoop::hoistedChecks so codegen can check them once up front.
+class VisitorRangeAnalysis : public Visitor {
+    struct Variable {
+        bool hasRange = false;
+        ValueRange range = {0, 0};
+        // Lower bound of the length of an array, -1 when unknown
+        int64_t arrayLength = -1;
+        bool isGlobal = false;
+    };
+
+    struct Loop {
+        ForLoop *node;
+        std::string variable;   // empty unless accesses may be hoisted
+        size_t scopeDepth;
+        bool hasNestedLoop = false;
+    };
+
+    bool globalTopLevel;
+    bool collectOnly = false;
+    int functionDepth = 0;
+    std::vector<std::map<std::string, Variable>> scopes;
+    std::vector<Loop> loops;
+    // Names assigned anywhere in the unit; their declarations give no range
+    std::set<std::string> assigned;
+    bool sawCall = false;
+
+    static std::set<std::string> assignedNames(ASTNode &node, bool *hasCall = nullptr);
+    const Variable *lookup(const std::string &name, size_t *depth = nullptr) const;
+    void declare(const std::string &name, const Variable &variable);
+    bool rangeOf(Expression *expr, ValueRange &range) const;
+    bool isInvariant(Expression *expr, const std::set<std::string> &bodyAssigned, bool bodyHasCall) const;
+    bool countedLoopRange(ForLoop &node, std::string &variable, ValueRange &range, bool &hoistable);
+    void checkAccess(ArrayAccess &node);
+
+public:
+    VisitorRangeAnalysis(bool globalTopLevel) : globalTopLevel(globalTopLevel), scopes(1) {}
+    virtual ~VisitorRangeAnalysis() = default;
+
+    // Annotates the nodes of one compilation unit
+    void run(std::vector<std::unique_ptr<ASTNode>> &nodeList);
+
+    void visitExpression(Expression& node);
+    void visitStatement(Statement& node);
+    void visitIntegerLiteral(IntegerLiteral& node);
+    void visitFloatLiteral(FloatLiteral& node);
+    void visitStringLiteral(StringLiteral& node);
+    void visitCharLiteral(CharLiteral& node);
+    void visitBoolLiteral(BoolLiteral& node);
+    void visitIdentifier(Identifier& node);
+    void visitUnary(Unary& node);
+    void visitBinary(Binary& node);
+    void visitComparison(Comparison& node);
+    void visitCallFunction(CallFunction& node);
+    void visitArrayAccess(ArrayAccess& node);
+    void visitAssignment(Assignment& node);
+    void visitExpressionStatement(ExpressionStatement& node);
+    void visitArrayDeclaration(ArrayDeclaration& node);
+    void visitVariableDeclaration(VariableDeclaration& node);
+    void visitPrint(Print& node);
+    void visitBlock(Block& node);
+    void visitCondition(Condition& node);
+    void visitForLoop(ForLoop& node);
+    void visitWhileLoop(WhileLoop& node);
+    void visitPrototypeFunction(PrototypeFunction& node);
+    void visitFunction(FunctionNode& node);
+    void visitReturn(Return& node);
+};
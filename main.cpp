@@ -1,53 +1,466 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
-#include <gc/gc.h>
+#include <cstring>
 #include "include/VisitorPrintNode.h"
 #include "include/Lexer.h"
 #include "include/Parser.h"
 #include "include/CodeGenContext.h"
 #include "include/OwnProgLangJIT.h"
+#include "include/Server.h"
+#include "include/Log.h"
+#include "include/GCManager.h"
+#include "include/GCWorkers.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <map>
 
-int main(int argc, char *argv[]){
+// Resident set size in KB, or -1 where /proc is not available
+static long currentRSS(){
+	std::ifstream statm("/proc/self/statm");
+	long pages = 0, residentPages = 0;
+	if (!(statm >> pages >> residentPages)){
+		return -1;
+	}
+	return residentPages * (llvm::sys::Process::getPageSizeEstimate() / 1024);
+}
 
-	// GC_INIT();
+// Byte count with an optional K, M or G suffix, e.g. 512K
+static bool parseByteSize(const char *text, size_t &bytes){
+	char *end;
+	unsigned long long value = strtoull(text, &end, 10);
+	if (end == text){
+		return false;
+	}
+	switch (*end){
+	case 'G': case 'g':
+		value <<= 10;
+		[[fallthrough]];
+	case 'M': case 'm':
+		value <<= 10;
+		[[fallthrough]];
+	case 'K': case 'k':
+		value <<= 10;
+		end++;
+	}
+	if (*end){
+		return false;
+	}
+	bytes = value;
+	return true;
+}
 
-	llvm::InitializeNativeTarget();
-	llvm::InitializeNativeTargetAsmPrinter();
-	llvm::InitializeNativeTargetAsmParser();
-    std::ifstream inputFile(argv[1]);
-	if (!inputFile.is_open()){
-		std::cout << "Error opening file" << "\n";
-		return 1;
+// A growth percentage, or "off"
+static bool parseGrowthPercent(const char *text, int &percent){
+	if (strcmp(text, "off") == 0){
+		percent = -1;
+		return true;
 	}
-    std::stringstream ss;
-	ss << inputFile.rdbuf();
-	std::string sourceCode = ss.str();
+	char *end;
+	long value = strtol(text, &end, 10);
+	if (end == text || *end || value < 0 || value > INT_MAX){
+		return false;
+	}
+	percent = value;
+	return true;
+}
+
+static std::vector<std::unique_ptr<ASTNode>> parseSource(const std::string &sourceCode){
 	Lexer lexer(sourceCode);
 	lexer.scanSourceCode();
 	int i = 0;
-	for (Token t : lexer.getTokenList()){
-		std::cout << "Token No." << i << " : " << t.type << " " << t.value << "\n";
-		i++;
+	if (Log::isDumpEnabled(Log::TOKENS) || Log::isEnabled(Log::LEXER, Log::TRACE)){
+		std::stringstream tokens;
+		for (Token t : lexer.getTokenList()){
+			tokens << "Token No." << i << " : " << t.type << " " << t.value << "\n";
+			i++;
+		}
+		if (Log::isDumpEnabled(Log::TOKENS)){
+			Log::writeDump(Log::TOKENS, tokens.str());
+		}
+		DNM_LOG(LEXER, TRACE) << "Tokens:\n" << tokens.str();
 	}
 	Parser parser(lexer.getTokenList());
 	parser.parse();
-	VisitorPrintNode visitor(std::cout);
 	auto nodeList = parser.getASTNodeList();
-	std::cout << "Node list size: " << nodeList.size() << "\n";
-	i = 0;
-	for (auto &node : nodeList){
-		std::cout << "Node No." << i << " : " << "\n";
-		if (!node->isChecked){
-			node->accept(visitor);
+	if (Log::isDumpEnabled(Log::AST) || Log::isEnabled(Log::PARSER, Log::TRACE)){
+		std::stringstream ast;
+		VisitorPrintNode visitor(ast);
+		ast << "Node list size: " << nodeList.size() << "\n";
+		i = 0;
+		for (auto &node : nodeList){
+			ast << "Node No." << i << " : " << "\n";
+			if (!node->isChecked){
+				node->accept(visitor);
+			}
+			i++;
+		}
+		if (Log::isDumpEnabled(Log::AST)){
+			Log::writeDump(Log::AST, ast.str());
+		}
+		DNM_LOG(PARSER, TRACE) << "AST:\n" << ast.str();
+	}
+	return nodeList;
+}
+
+static bool readFile(const std::string &path, std::string &contents){
+	std::ifstream inputFile(path);
+	if (!inputFile.is_open()){
+		return false;
+	}
+	std::stringstream ss;
+	ss << inputFile.rdbuf();
+	contents = ss.str();
+	return true;
+}
+
+// Scripts of a batch: every .dnm file of a directory, or the paths listed one
+// per line in a manifest file
+static std::vector<std::string> collectScripts(const std::string &batchPath){
+	std::vector<std::string> scripts;
+	if (llvm::sys::fs::is_directory(batchPath)){
+		std::error_code EC;
+		for (llvm::sys::fs::directory_iterator it(batchPath, EC), end; it != end && !EC; it.increment(EC)){
+			if (llvm::sys::path::extension(it->path()) == ".dnm"){
+				scripts.push_back(it->path());
+			}
+		}
+		std::sort(scripts.begin(), scripts.end());
+		return scripts;
+	}
+	std::ifstream manifest(batchPath);
+	std::string line;
+	while (std::getline(manifest, line)){
+		if (!line.empty() && line[0] != '#'){
+			scripts.push_back(line);
+		}
+	}
+	return scripts;
+}
+
+// Runs every script of the batch in one warmed-up JIT. Each script gets its own
+// JITDylib and its printed output goes to <outDir>/<script name>.out. Returns
+// 1 if any script could not be run or failed to compile or run.
+static int runBatch(const std::string &batchPath, const std::string &outDir){
+	auto scripts = collectScripts(batchPath);
+	if (scripts.empty()){
+		std::cerr << "No scripts found in " << batchPath << "\n";
+		return 1;
+	}
+	// Outputs are named by stem, so two scripts of the same name would
+	// overwrite each other's output
+	std::map<std::string, std::string> scriptOfStem;
+	for (auto &script : scripts){
+		std::string stem = llvm::sys::path::stem(script).str();
+		auto inserted = scriptOfStem.emplace(stem, script);
+		if (!inserted.second){
+			std::cerr << "Scripts " << inserted.first->second << " and " << script << " would both write " << stem << ".out\n";
+			return 1;
+		}
+	}
+	if (auto EC = llvm::sys::fs::create_directories(outDir)){
+		std::cerr << "Cannot create output directory " << outDir << ": " << EC.message() << "\n";
+		return 1;
+	}
+
+	auto jit = std::move(*llvm::orc::OwnProgLangJIT::Create());
+	int failed = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (auto &script : scripts){
+		std::string sourceCode;
+		if (!readFile(script, sourceCode)){
+			std::cerr << "Error opening file " << script << "\n";
+			failed++;
+			continue;
+		}
+
+		llvm::SmallString<128> outPath(outDir);
+		llvm::sys::path::append(outPath, llvm::sys::path::stem(script) + ".out");
+		FILE *outFile = fopen(outPath.c_str(), "w");
+		if (!outFile){
+			std::cerr << "Cannot write " << outPath.str().str() << "\n";
+			failed++;
+			continue;
+		}
+
+		auto dylib = jit->createScriptDylib(llvm::sys::path::stem(script));
+		if (!dylib){
+			std::cerr << "Failed to create JITDylib: " << llvm::toString(dylib.takeError()) << "\n";
+			fclose(outFile);
+			failed++;
+			continue;
+		}
+
+		FileOutputSink sink(outFile);
+		setOutputSink(&sink);
+		bool succeeded;
+		{
+			CodeGenContext context(*jit, *dylib);
+			// The statements that did compile still run, as they do for a single script
+			succeeded = context.generateCode(parseSource(sourceCode)) && context.runCode() && context.failedNodes == 0;
+		}
+		setOutputSink(nullptr);
+		fclose(outFile);
+		if (!succeeded){
+			std::cerr << "Script " << script << " failed\n";
+			failed++;
+		}
+
+		if (auto Err = jit->removeScriptDylib(*dylib)){
+			std::cerr << "Failed to remove JITDylib: " << llvm::toString(std::move(Err)) << "\n";
+		}
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
 
+	std::cerr << "Batch: " << scripts.size() << " scripts (" << failed << " failed) in "
+	          << elapsed.count() << " s, " << scripts.size() / elapsed.count() << " scripts/sec\n";
+	return failed ? 1 : 0;
+}
+
+// A REPL input is complete once its brackets are balanced and it ends a statement
+static bool isCompleteInput(const std::string &input){
+	int depth = 0;
+	char quote = 0;
+	char last = 0;
+	for (char c : input){
+		if (quote){
+			if (c == quote){
+				quote = 0;
+			}
+			continue;
+		}
+		if (c == '"' || c == '\''){
+			quote = c;
+		} else if (c == '{' || c == '('){
+			depth++;
+		} else if (c == '}' || c == ')'){
+			depth--;
+		}
+		if (!isspace(static_cast<unsigned char>(c))){
+			last = c;
+		}
+	}
+	return depth <= 0 && (last == ';' || last == '}');
+}
+
+// Interactive mode: every input is compiled into its own module and added to
+// the same JITDylib. Top-level variables become globals and functions stay
+// defined, so later inputs use them without recompiling anything.
+static int runRepl(){
+	auto jit = std::move(*llvm::orc::OwnProgLangJIT::Create());
+	auto dylib = jit->createScriptDylib("repl");
+	if (!dylib){
+		std::cerr << "Failed to create JITDylib: " << llvm::toString(dylib.takeError()) << "\n";
+		return 1;
+	}
+	CodeGenContext context(*jit, *dylib);
+	context.globalTopLevel = true;
+
+	std::string input, line;
+	int inputCount = 0;
+	std::cout << "> " << std::flush;
+	while (std::getline(std::cin, line)){
+		if (input.empty() && (line == ":quit" || line == ":q")){
+			break;
+		}
+		input += line + "\n";
+		if (input.find_first_not_of(" \t\n") == std::string::npos){
+			input.clear();
+			std::cout << "> " << std::flush;
+			continue;
+		}
+		if (!isCompleteInput(input)){
+			std::cout << "... " << std::flush;
+			continue;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		context.mainFunctionName = "__repl_" + std::to_string(inputCount++);
+		if (context.generateCode(parseSource(input))){
+			context.runCode();
 		}
-		i++;
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		std::cerr << "[" << elapsed.count() << " ms]\n";
+
+		input.clear();
+		std::cout << "> " << std::flush;
 	}
-	CodeGenContext context;
-	context.generateCode(std::move(nodeList));
+	return 0;
+}
 
-	context.runCode();
+int main(int argc, char *argv[]){
+	int repeat = 1;
+	int argi = 1;
+	bool repl = false;
+	std::string batchPath, outDir = "batch_out", socketPath;
+	unsigned workers = std::thread::hardware_concurrency();
+	if (const char *logSpec = getenv("DNM_LOG")){
+		Log::configure(logSpec);
+	}
+	if (const char *percent = getenv("DNM_GC_PERCENT")){
+		if (!parseGrowthPercent(percent, GCManager::defaultGrowthPercent)){
+			std::cerr << "Invalid DNM_GC_PERCENT: " << percent << "\n";
+			return 1;
+		}
+	}
+	if (const char *limit = getenv("DNM_HEAP_LIMIT")){
+		if (!parseByteSize(limit, GCManager::defaultHeapLimit)){
+			std::cerr << "Invalid DNM_HEAP_LIMIT: " << limit << "\n";
+			return 1;
+		}
+	}
+	while (argi < argc && strncmp(argv[argi], "--", 2) == 0){
+		if (strcmp(argv[argi], "--repl") == 0){
+			repl = true;
+			argi++;
+			continue;
+		}
+		if (strcmp(argv[argi], "--bounds-check") == 0){
+			CodeGenContext::defaultBoundsCheck = true;
+			argi++;
+			continue;
+		}
+		if (strcmp(argv[argi], "--concurrent-gc") == 0){
+			GCManager::defaultConcurrentSweep = true;
+			argi++;
+			continue;
+		}
+		if (argi + 1 >= argc){
+			break;
+		}
+		if (strcmp(argv[argi], "--repeat") == 0){
+			repeat = atoi(argv[argi + 1]);
+		} else if (strcmp(argv[argi], "--batch") == 0){
+			batchPath = argv[argi + 1];
+		} else if (strcmp(argv[argi], "--out") == 0){
+			outDir = argv[argi + 1];
+		} else if (strcmp(argv[argi], "--serve") == 0){
+			socketPath = argv[argi + 1];
+		} else if (strcmp(argv[argi], "--workers") == 0){
+			workers = atoi(argv[argi + 1]);
+		} else if (strcmp(argv[argi], "--gc") == 0){
+			if (strcmp(argv[argi + 1], "precise") == 0){
+				GCBackend::defaultKind = GCBackend::PRECISE;
+			} else if (strcmp(argv[argi + 1], "boehm") == 0){
+				GCBackend::defaultKind = GCBackend::BOEHM;
+			} else {
+				std::cerr << "Unknown garbage collector: " << argv[argi + 1] << "\n";
+				return 1;
+			}
+			if (!GCBackend::isAvailable(GCBackend::defaultKind)){
+				std::cerr << "This build has no Boehm GC support; build it with make main-boehm\n";
+				return 1;
+			}
+		} else if (strcmp(argv[argi], "--nursery-size") == 0){
+			if (!parseByteSize(argv[argi + 1], GCManager::defaultNurserySize)){
+				std::cerr << "Invalid nursery size: " << argv[argi + 1] << "\n";
+				return 1;
+			}
+		} else if (strcmp(argv[argi], "--gc-percent") == 0){
+			if (!parseGrowthPercent(argv[argi + 1], GCManager::defaultGrowthPercent)){
+				std::cerr << "Invalid GC percentage: " << argv[argi + 1] << "\n";
+				return 1;
+			}
+		} else if (strcmp(argv[argi], "--heap-limit") == 0){
+			if (!parseByteSize(argv[argi + 1], GCManager::defaultHeapLimit)){
+				std::cerr << "Invalid heap limit: " << argv[argi + 1] << "\n";
+				return 1;
+			}
+		} else if (strcmp(argv[argi], "--gc-stats") == 0){
+			if (strcmp(argv[argi + 1], "text") == 0){
+				GCTelemetry::dumpFormat = GCTelemetry::TEXT;
+			} else if (strcmp(argv[argi + 1], "json") == 0){
+				GCTelemetry::dumpFormat = GCTelemetry::JSON;
+			} else {
+				std::cerr << "Invalid GC stats format: " << argv[argi + 1] << "\n";
+				return 1;
+			}
+		} else if (strcmp(argv[argi], "--gc-threads") == 0){
+			GCWorkers::defaultThreads = std::max(1, atoi(argv[argi + 1]));
+		} else if (strcmp(argv[argi], "--log") == 0){
+			if (!Log::configure(argv[argi + 1])){
+				return 1;
+			}
+		} else if (strcmp(argv[argi], "--dump-tokens") == 0){
+			Log::setDumpPath(Log::TOKENS, argv[argi + 1]);
+		} else if (strcmp(argv[argi], "--dump-ast") == 0){
+			Log::setDumpPath(Log::AST, argv[argi + 1]);
+		} else if (strcmp(argv[argi], "--dump-ir") == 0){
+			Log::setDumpPath(Log::IR, argv[argi + 1]);
+		} else if (strcmp(argv[argi], "--dump-optimized-ir") == 0){
+			Log::setDumpPath(Log::OPTIMIZED_IR, argv[argi + 1]);
+		} else {
+			break;
+		}
+		argi += 2;
+	}
+	if (argi >= argc && batchPath.empty() && socketPath.empty() && !repl){
+		std::cout << "Usage: main [--repeat <count>] <file.dnm>" << "\n";
+		std::cout << "       main --repl" << "\n";
+		std::cout << "       main --batch <dir|manifest> [--out <dir>]" << "\n";
+		std::cout << "       main --serve <socket> [--workers <count>]" << "\n";
+		std::cout << "Options: --bounds-check (stop the program at array indexes out of bounds; works with every mode)" << "\n";
+		std::cout << "         --gc <precise|boehm> (garbage collector; boehm needs a build with make main-boehm; default precise)" << "\n";
+		std::cout << "         --nursery-size <bytes> (young generation of each program, e.g. 512K; 0 disables it; default 2M)" << "\n";
+		std::cout << "         --gc-percent <percent|off> (old generation growth that triggers a full collection; default 100, or DNM_GC_PERCENT)" << "\n";
+		std::cout << "         --heap-limit <bytes> (collect as often as needed to stay below it, stop the program beyond it; or DNM_HEAP_LIMIT)" << "\n";
+		std::cout << "         --gc-threads <count> (threads sweeping large heaps; default one per core)" << "\n";
+		std::cout << "         --concurrent-gc (sweep the old generation on a background thread; collections only pause to mark)" << "\n";
+		std::cout << "Diagnostics: --log <category=level,...> (lexer, parser, codegen, jit, gc, all; info, debug, trace)" << "\n";
+		std::cout << "             --gc-stats <text|json> (collector statistics of each program on stderr when it ends)" << "\n";
+		std::cout << "             --dump-tokens <file> --dump-ast <file> --dump-ir <file> --dump-optimized-ir <file>" << "\n";
+		return 1;
+	}
+
+	GCBackend::initialize(GCBackend::defaultKind);
+	llvm::InitializeNativeTarget();
+	llvm::InitializeNativeTargetAsmPrinter();
+	llvm::InitializeNativeTargetAsmParser();
+
+	if (repl){
+		return runRepl();
+	}
+	if (!batchPath.empty()){
+		return runBatch(batchPath, outDir);
+	}
+	if (!socketPath.empty()){
+		auto jit = std::move(*llvm::orc::OwnProgLangJIT::Create());
+		CompileServer server(*jit, socketPath, std::max(workers, 1u));
+		return server.run();
+	}
+
+	std::string sourceCode;
+	if (!readFile(argv[argi], sourceCode)){
+		std::cout << "Error opening file" << "\n";
+		return 1;
+	}
+
+	if (repeat == 1){
+		CodeGenContext context;
+		context.generateCode(parseSource(sourceCode));
+		// A runtime error ends the program with status 1
+		return context.runCode() ? 0 : 1;
+	}
+
+	// Compile and run the script over and over in one JIT, releasing each unit
+	// after it ran, and report RSS so leaks in the JIT show up as growth.
+	auto jit = std::move(*llvm::orc::OwnProgLangJIT::Create());
+	for (int run = 1; run <= repeat; run++){
+		{
+			CodeGenContext context(*jit);
+			context.generateCode(parseSource(sourceCode));
+			context.runCode();
+		}
+		if (run == 1 || run % 1000 == 0 || run == repeat){
+			auto stats = jit->getMemoryStats();
+			std::cerr << "run " << run << ": rss " << currentRSS() << " KB, jit reserved "
+			          << stats.bytesReserved << " bytes, used " << stats.bytesUsed << " bytes\n";
+		}
+	}
 
 	return 0;
-}
\ No newline at end of file
+}
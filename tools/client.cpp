@@ -0,0 +1,116 @@
+// Client for `main --serve`: sends a script to the resident compile server,
+// streams its output to stdout and its errors to stderr, and exits with the
+// script's status.
+//
+// Usage: dnm-client [--socket <path>] [--path] <file.dnm>
+//   --path sends the file path instead of its contents, so the server reads it itself
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static bool sendAll(int fd, const char *data, size_t size){
+    while (size > 0){
+        ssize_t sent = send(fd, data, size, 0);
+        if (sent <= 0){
+            return false;
+        }
+        data += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+static bool readLine(int fd, std::string &line){
+    line.clear();
+    char c;
+    while (recv(fd, &c, 1, 0) == 1){
+        if (c == '\n'){
+            return true;
+        }
+        line.push_back(c);
+    }
+    return false;
+}
+
+int main(int argc, char *argv[]){
+    std::string socketPath = "/tmp/dynamite.sock";
+    bool sendPath = false;
+    int argi = 1;
+    while (argi < argc && strncmp(argv[argi], "--", 2) == 0){
+        if (strcmp(argv[argi], "--socket") == 0 && argi + 1 < argc){
+            socketPath = argv[++argi];
+        } else if (strcmp(argv[argi], "--path") == 0){
+            sendPath = true;
+        }
+        argi++;
+    }
+    if (argi >= argc){
+        std::cerr << "Usage: dnm-client [--socket <path>] [--path] <file.dnm>\n";
+        return 2;
+    }
+
+    std::string request;
+    if (sendPath){
+        char resolved[4096];
+        const char *path = realpath(argv[argi], resolved) ? resolved : argv[argi];
+        request = std::string("RUN ") + path + "\n";
+    } else {
+        std::ifstream inputFile(argv[argi]);
+        if (!inputFile.is_open()){
+            std::cerr << "Error opening file " << argv[argi] << "\n";
+            return 2;
+        }
+        std::stringstream ss;
+        ss << inputFile.rdbuf();
+        std::string sourceCode = ss.str();
+        request = "SOURCE " + std::to_string(sourceCode.size()) + "\n" + sourceCode;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0){
+        std::cerr << "Cannot connect to " << socketPath << ": " << strerror(errno) << "\n";
+        return 2;
+    }
+    if (!sendAll(fd, request.data(), request.size())){
+        std::cerr << "Failed to send request\n";
+        return 2;
+    }
+
+    std::string header;
+    std::string chunk;
+    while (readLine(fd, header)){
+        bool isOutput = header.compare(0, 4, "OUT ") == 0;
+        if (isOutput || header.compare(0, 4, "ERR ") == 0){
+            size_t size = strtoul(header.c_str() + 4, nullptr, 10);
+            chunk.resize(size);
+            size_t received = 0;
+            while (received < size){
+                ssize_t n = recv(fd, &chunk[received], size - received, 0);
+                if (n <= 0){
+                    std::cerr << "Connection closed mid-frame\n";
+                    return 2;
+                }
+                received += n;
+            }
+            FILE *stream = isOutput ? stdout : stderr;
+            fwrite(chunk.data(), 1, size, stream);
+            fflush(stream);
+        } else if (header.compare(0, 5, "EXIT ") == 0){
+            close(fd);
+            return atoi(header.c_str() + 5);
+        }
+    }
+
+    std::cerr << "Connection closed without a result\n";
+    return 2;
+}
@@ -0,0 +1,106 @@
+// Allocation microbenchmark for the GC heap: allocation throughput against
+// calloc/free, and the cost of a sweep per MB of heap. With --concurrent the
+// sweep runs on a background thread, and the pause is the time to start it.
+//
+// Usage: gcbench [--objects <count>] [--live <percent>] [--threads <count>] [--concurrent]
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "../include/GCHeap.h"
+#include "../include/GCWorkers.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start){
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Payload sizes of a run: mostly small numbers, now and then an array
+static std::vector<size_t> makeSizes(size_t count){
+    std::vector<size_t> sizes(count);
+    uint64_t seed = 42;
+    for (auto &size : sizes){
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        unsigned roll = (seed >> 33) % 100;
+        size = roll < 80 ? 8 + (seed >> 40) % 56 : roll < 99 ? 64 + (seed >> 40) % 448 : 1024 + (seed >> 40) % 16384;
+    }
+    return sizes;
+}
+
+int main(int argc, char *argv[]){
+    size_t count = 2000000;
+    unsigned livePercent = 10;
+    bool concurrent = false;
+    for (int argi = 1; argi < argc; argi += 2){
+        if (strcmp(argv[argi], "--concurrent") == 0){
+            concurrent = true;
+            argi--;
+        } else if (argi + 1 >= argc){
+            break;
+        } else if (strcmp(argv[argi], "--objects") == 0){
+            count = strtoull(argv[argi + 1], nullptr, 10);
+        } else if (strcmp(argv[argi], "--live") == 0){
+            livePercent = atoi(argv[argi + 1]);
+        } else if (strcmp(argv[argi], "--threads") == 0){
+            GCWorkers::defaultThreads = atoi(argv[argi + 1]);
+        }
+    }
+    std::vector<size_t> sizes = makeSizes(count);
+    std::vector<void *> objects(count);
+
+    auto start = Clock::now();
+    for (size_t i = 0; i < count; i++){
+        objects[i] = calloc(1, sizes[i] + 16);
+    }
+    double mallocSeconds = secondsSince(start);
+    for (void *object : objects){
+        free(object);
+    }
+
+    GCHeap heap;
+    start = Clock::now();
+    for (size_t i = 0; i < count; i++){
+        objects[i] = heap.allocate(HeapKind::Array, sizes[i]);
+    }
+    double heapSeconds = secondsSince(start);
+    double heapMB = heap.getStats().bytesInUse / 1048576.0;
+
+    std::cout << count << " objects, " << heapMB << " MB\n";
+    std::cout << "calloc:  " << count / mallocSeconds / 1e6 << " M objects/sec\n";
+    std::cout << "GC heap: " << count / heapSeconds / 1e6 << " M objects/sec\n";
+
+    // Every livePercent-th object survives, spread over the whole heap
+    start = Clock::now();
+    for (size_t i = 0; i < count; i++){
+        if (i % 100 < livePercent){
+            heap.mark(objects[i]);
+        }
+    }
+    double markSeconds = secondsSince(start);
+    start = Clock::now();
+    if (concurrent){
+        heap.startSweep();
+        double pauseSeconds = secondsSince(start);
+        heap.finishSweep(true);
+        std::cout << "concurrent sweep pause: " << pauseSeconds * 1e6 << " us\n";
+    } else {
+        heap.sweep();
+    }
+    double sweepSeconds = secondsSince(start);
+    std::cout << "mark " << livePercent << "%: " << markSeconds * 1e3 << " ms, sweep on " << GCWorkers::instance().getThreads()
+              << " threads: " << sweepSeconds * 1e3 << " ms ("
+              << sweepSeconds * 1e3 / heapMB << " ms/MB), " << heap.getStats().bytesInUse / 1048576.0 << " MB left\n";
+
+    // Refilling the swept heap reuses the free lists
+    start = Clock::now();
+    for (size_t i = 0; i < count; i++){
+        if (i % 100 >= livePercent){
+            objects[i] = heap.allocate(HeapKind::Array, sizes[i]);
+        }
+    }
+    double refillSeconds = secondsSince(start);
+    std::cout << "refill:  " << count * (100 - livePercent) / 100 / refillSeconds / 1e6 << " M objects/sec\n";
+    return 0;
+}